@@ -10,8 +10,10 @@ set PYTHON_VERSION=%_OLD_PYTHON_VERSION%
 
 set MLKL_MNIST_EXT=C:\Users\Julien\Documents\Dev\MLKL\core\c++\mnist
 set MLKL_CIFAR_EXT=C:\Users\Julien\Documents\Dev\MLKL\core\c++\cifar
+set MLKL_AUGMENT_EXT=C:\Users\Julien\Documents\Dev\MLKL\core\c++\augment
+set MLKL_SIMD_EXT=C:\Users\Julien\Documents\Dev\MLKL\core\c++\simd
 set MLKL_EXTS=C:\Users\Julien\Documents\Dev\MLKL\core\kl
  
 set FABRIC_EXTS_PATH=%FABRIC_DIR%\Exts
-set FABRIC_EXTS_PATH=%MLKL_CIFAR_EXT%;%MLKL_MNIST_EXT%;%MLKL_EXTS%;%FABRIC_EXTS_PATH%
+set FABRIC_EXTS_PATH=%MLKL_SIMD_EXT%;%MLKL_AUGMENT_EXT%;%MLKL_CIFAR_EXT%;%MLKL_MNIST_EXT%;%MLKL_EXTS%;%FABRIC_EXTS_PATH%
 
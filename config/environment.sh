@@ -22,9 +22,11 @@ echo "  Set PYTHONPATH=\"$PYTHONPATH\""
 
 FABRIC_EXTS_PATH=$FABRIC_DIR/Exts
 KLML_EXTS_CPP_MNIST_PATH=/Volumes/MIKOO_Backup/JULIEN/Dev/KL_ML/core/c++/MNIST
+KLML_EXTS_CPP_AUGMENT_PATH=/Volumes/MIKOO_Backup/JULIEN/Dev/KL_ML/core/c++/augment
+KLML_EXTS_CPP_SIMD_PATH=/Volumes/MIKOO_Backup/JULIEN/Dev/KL_ML/core/c++/simd
 KLML_EXTS_PATH=/Volumes/MIKOO_Backup/JULIEN/Dev/KL_ML/core/kl
 
-KLML_EXTS_CPP_PATH=$KLML_EXTS_CPP_MNIST_PATH
+KLML_EXTS_CPP_PATH=$KLML_EXTS_CPP_MNIST_PATH:$KLML_EXTS_CPP_AUGMENT_PATH:$KLML_EXTS_CPP_SIMD_PATH
 FABRIC_EXTS_PATH=$FABRIC_EXTS_PATH:$KLML_EXTS_CPP_PATH:$KLML_EXTS_PATH
 export FABRIC_EXTS_PATH
 echo "  Set FABRIC_EXTS_PATH=\"$FABRIC_EXTS_PATH\""
@@ -19,8 +19,23 @@
 #include <algorithm>  
 #include <functional>
 #include <type_traits>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <string.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 using namespace std;
 
+#include <MkPhilox.h>
 #include <MkMNIST.h>
 #include <FabricEDK.h>
 using namespace Fabric::EDK;
@@ -39,38 +54,135 @@ void ReverseEndianFunc(unsigned char * b, int n) {
   }
 }
 
-FABRIC_EXT_EXPORT void MkMNIST_parseLabels(
-  KL::VariableArray<KL::UInt32>::IOParam labels, 
-  KL::MkMNIST::INParam expr,
-  KL::String::INParam path) 
-{
+/// Read-only memory mapping of a whole file.
+/// The dataset files are only read once, so we let the OS page them in 
+/// instead of pulling them through an ifstream.
+class MkMappedFile {
+public:
+  MkMappedFile(const char *path) : m_data(0), m_size(0) {
+#if defined(_WIN32)
+    m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    m_mapping = 0;
+    if (m_file == INVALID_HANDLE_VALUE)
+      return;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+      return;
+    m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+    if (m_mapping == 0)
+      return;
+    m_data = (const uint8_t *) MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    m_size = m_data ? size_t(size.QuadPart) : 0;
+#else
+    m_fd = open(path, O_RDONLY);
+    if (m_fd < 0)
+      return;
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || st.st_size == 0)
+      return;
+    void *addr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (addr == MAP_FAILED)
+      return;
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    m_data = (const uint8_t *) addr;
+    m_size = size_t(st.st_size);
+#endif
+  }
 
-  ifstream ifs(path.data(), ios::in | ios::binary);
-  if (ifs.bad() || ifs.fail())
-  {
-    cerr << "Error MkMNIST_parseLabels : image-file error" << endl;
-    return;
+  ~MkMappedFile() {
+#if defined(_WIN32)
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+    if (m_data) munmap((void *) m_data, m_size);
+    if (m_fd >= 0) close(m_fd);
+#endif
   }
 
-  uint32_t magic_number;
-  uint32_t num_items;
-  ifs.read((char*) &magic_number, 4);
-  ifs.read((char*) &num_items, 4);
-  ReverseEndian(magic_number);
-  ReverseEndian(num_items);
-  if (magic_number != 0x00000801 || num_items <= 0)
+  bool isValid() const { return m_data != 0; }
+  const uint8_t *data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+private:
+  MkMappedFile(const MkMappedFile &);
+  MkMappedFile &operator=(const MkMappedFile &);
+
+  const uint8_t *m_data;
+  size_t m_size;
+#if defined(_WIN32)
+  HANDLE m_file;
+  HANDLE m_mapping;
+#else
+  int m_fd;
+#endif
+};
+
+/// Flush a closed file to the disk, so renaming it never exposes a partially written file after a crash
+inline bool SyncFile(const string &path) {
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  bool success = FlushFileBuffers(file) != 0;
+  CloseHandle(file);
+  return success;
+#else
+  int fd = open(path.c_str(), O_WRONLY);
+  if (fd < 0)
+    return false;
+  bool success = fsync(fd) == 0;
+  close(fd);
+  return success;
+#endif
+}
+
+/// Atomically replace the file to by from, to is either the old or the new file, never missing
+inline bool AtomicReplace(const string &from, const string &to) {
+#if defined(_WIN32)
+  return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  if (rename(from.c_str(), to.c_str()) != 0)
+    return false;
+  // The rename itself is only durable once its directory is synced
+  size_t slash = to.find_last_of('/');
+  string dir = (slash == string::npos) ? string(".") : (slash == 0 ? string("/") : to.substr(0, slash));
+  int fd = open(dir.c_str(), O_RDONLY);
+  if (fd >= 0)
   {
-    cerr << "Error MkMNIST_parseLabels : image-file format error" << endl;
-    return;
+    fsync(fd);
+    close(fd);
   }
+  return true;
+#endif
+}
 
-  labels.resize(num_items);
-  for(size_t i=0; i<num_items; i++) 
+/// Make to a second name of the file from, copied if the file system has no hard links
+/// to must not exist, from is left untouched
+inline bool LinkOrCopy(const string &from, const string &to) {
+#if defined(_WIN32)
+  if (CreateHardLinkA(to.c_str(), from.c_str(), 0))
+    return true;
+#else
+  if (link(from.c_str(), to.c_str()) == 0)
+    return true;
+#endif
+  string tmp_path = to + ".tmp";
   {
-    uint8_t label;
-    ifs.read((char*) &label, 1);
-    labels[i] = KL::UInt32(label);
+    ifstream ifs(from.c_str(), ios::in | ios::binary);
+    ofstream ofs(tmp_path.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!ifs.is_open() || !ofs.is_open())
+      return false;
+    ofs << ifs.rdbuf();
+    if (ofs.fail())
+      return false;
   }
+  return SyncFile(tmp_path) && AtomicReplace(tmp_path, to);
+}
+
+/// IDX files are stored in big-endian
+inline uint32_t ReadBigEndian32(const uint8_t *b) {
+  return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3]);
 }
 
 struct mnist_header {
@@ -80,53 +192,109 @@ struct mnist_header {
   uint32_t num_cols;
 };
 
-inline void parseMNISTImage(
-  ifstream& ifs,
-  const mnist_header& header,
-  const KL::Float64 &scale_min,
-  const KL::Float64 &scale_max,
-  const KL::UInt32 &x_padding,
-  const KL::UInt32 &y_padding,
-  KL::VariableArray<KL::Float64> &dst) 
-{
-  const int width = header.num_cols + 2 * x_padding;
-  const int height = header.num_rows + 2 * y_padding;
-
-  vector<uint8_t> image_vec(header.num_rows * header.num_cols);
-  ifs.read((char*) &image_vec[0], header.num_rows * header.num_cols);
-
-  dst.resize(width * height);
-  for (size_t i = 0; i < dst.size(); i++)
-    dst[i] = scale_min;
+/// Check the labels header once, return a pointer on the first label
+inline const uint8_t *parseMNISTLabelsHeader(const MkMappedFile &file, uint32_t &num_items) {
   
-  for (size_t y = 0; y < header.num_rows; y++)
-  { 
-    for (size_t x = 0; x < header.num_cols; x++)
-      dst[width * (y + y_padding) + x + x_padding]
-      = (image_vec[y * header.num_cols + x] / 255.0) * (scale_max - scale_min) + scale_min;
+  if (!file.isValid() || file.size() < 8)
+  {
+    cerr << "Error parseMNISTLabelsHeader : label-file error" << endl;
+    return 0;
   }
+
+  const uint8_t *b = file.data();
+  uint32_t magic_number = ReadBigEndian32(b);
+  num_items = ReadBigEndian32(b + 4);
+  if (magic_number != 0x00000801 || num_items <= 0 || file.size() < 8 + size_t(num_items))
+  {
+    cerr << "Error parseMNISTLabelsHeader : label-file format error" << endl;
+    return 0;
+  }
+  return b + 8;
 }
 
-inline void parseMNISTHeader(ifstream& ifs, mnist_header& header) {
+/// Check the images header once, return a pointer on the first pixel
+inline const uint8_t *parseMNISTHeader(const MkMappedFile &file, mnist_header& header) {
   
-  ifs.read((char*) &header.magic_number, 4);
-  ifs.read((char*) &header.num_items, 4);
-  ifs.read((char*) &header.num_rows, 4);
-  ifs.read((char*) &header.num_cols, 4);
-  ReverseEndian( header.magic_number);
-  ReverseEndian( header.num_items);
-  ReverseEndian( header.num_rows);
-  ReverseEndian( header.num_cols);
+  if (!file.isValid() || file.size() < 16)
+  {
+    cerr << "Error parseMNISTHeader : file error" << endl;
+    return 0;
+  }
+
+  const uint8_t *b = file.data();
+  header.magic_number = ReadBigEndian32(b);
+  header.num_items = ReadBigEndian32(b + 4);
+  header.num_rows = ReadBigEndian32(b + 8);
+  header.num_cols = ReadBigEndian32(b + 12);
   if (header.magic_number != 0x00000803 || header.num_items <= 0)
   {
     cerr << "Error parseMNISTHeader : image-file format error" << endl;
-    return;
+    return 0;
   }
-  if (ifs.fail() || ifs.bad())
+
+  size_t expected = 16 + size_t(header.num_items) * header.num_rows * header.num_cols;
+  if (file.size() < expected)
   {
-    cerr << "Error parseMNISTHeader : file error" << endl;
-    return;
+    cerr << "Error parseMNISTHeader : truncated image-file" << endl;
+    return 0;
+  }
+  return b + 16;
+}
+
+/// Normalization table, a pixel can only take 256 values
+inline void buildNormalizationTable(
+  double scale_min,
+  double scale_max,
+  double table[256])
+{
+  for (int v = 0; v < 256; v++)
+    table[v] = (v / 255.0) * (scale_max - scale_min) + scale_min;
+}
+
+/// Normalize and pad one image in a single pass
+template<typename T> inline void normalizeMNISTImage(
+  const uint8_t *src,
+  uint32_t num_rows,
+  uint32_t num_cols,
+  uint32_t x_padding,
+  uint32_t y_padding,
+  const double table[256],
+  T *dst) 
+{
+  const uint32_t width = num_cols + 2 * x_padding;
+  const uint32_t height = num_rows + 2 * y_padding;
+  const T pad = T(table[0]);
+
+  T *row = dst;
+  for (uint32_t y = 0; y < y_padding * width; y++)
+    *row++ = pad;
+
+  for (uint32_t y = 0; y < num_rows; y++)
+  {
+    for (uint32_t x = 0; x < x_padding; x++) *row++ = pad;
+    const uint8_t *line = src + y * num_cols;
+    for (uint32_t x = 0; x < num_cols; x++) *row++ = T(table[line[x]]);
+    for (uint32_t x = 0; x < x_padding; x++) *row++ = pad;
   }
+
+  for (uint32_t y = (num_rows + y_padding) * width; y < height * width; y++)
+    *row++ = pad;
+}
+
+FABRIC_EXT_EXPORT void MkMNIST_parseLabels(
+  KL::VariableArray<KL::UInt32>::IOParam labels, 
+  KL::MkMNIST::INParam expr,
+  KL::String::INParam path) 
+{
+  MkMappedFile file(path.data());
+  uint32_t num_items = 0;
+  const uint8_t *src = parseMNISTLabelsHeader(file, num_items);
+  if (!src)
+    return;
+
+  labels.resize(num_items);
+  for(size_t i=0; i<num_items; i++) 
+    labels[i] = KL::UInt32(src[i]);
 }
 
 FABRIC_EXT_EXPORT void MkMNIST_parseImages(
@@ -138,37 +306,945 @@ FABRIC_EXT_EXPORT void MkMNIST_parseImages(
   KL::Float64 x_padding,
   KL::Float64 y_padding) 
 {
-  ifstream ifs(path.data(), ios::in | ios::binary);
-  if (ifs.bad() || ifs.fail())
+  MkMappedFile file(path.data());
+  mnist_header header;
+  const uint8_t *src = parseMNISTHeader(file, header);
+  if (!src)
     return;
 
-  mnist_header header;
-  parseMNISTHeader(ifs, header);
+  double table[256];
+  buildNormalizationTable(scale_min, scale_max, table);
+
+  const uint32_t x_pad = uint32_t(x_padding);
+  const uint32_t y_pad = uint32_t(y_padding);
+  const size_t image_size = header.num_rows * header.num_cols;
+  const size_t padded_size = (header.num_cols + 2 * x_pad) * (header.num_rows + 2 * y_pad);
 
   images.resize(header.num_items);
   for (size_t i = 0; i < header.num_items; i++) 
-    parseMNISTImage(ifs, header, scale_min, scale_max, x_padding, y_padding, images[i]);
+  {
+    images[i].resize(padded_size);
+    normalizeMNISTImage(src + i * image_size, header.num_rows, header.num_cols, 
+      x_pad, y_pad, table, &images[i][0]);
+  }
+}
+
+/// Normalize and pad all the images in a single block, T is the network precision
+template<typename T> inline KL::UInt32 MkMNISTParseImagesFlat(
+  const char *path,
+  double scale_min,
+  double scale_max,
+  uint32_t x_padding,
+  uint32_t y_padding,
+  KL::VariableArray<T> &images, 
+  KL::UInt32 &width,
+  KL::UInt32 &height) 
+{
+  MkMappedFile file(path);
+  mnist_header header;
+  const uint8_t *src = parseMNISTHeader(file, header);
+  if (!src)
+    return 0;
+
+  double table[256];
+  buildNormalizationTable(scale_min, scale_max, table);
+
+  width = header.num_cols + 2 * x_padding;
+  height = header.num_rows + 2 * y_padding;
+  const size_t image_size = header.num_rows * header.num_cols;
+  const size_t padded_size = width * height;
+
+  images.resize(header.num_items * padded_size);
+  for (size_t i = 0; i < header.num_items; i++) 
+    normalizeMNISTImage(src + i * image_size, header.num_rows, header.num_cols, 
+      x_padding, y_padding, table, &images[i * padded_size]);
+
+  return header.num_items;
+}
+
+FABRIC_EXT_EXPORT KL::UInt32 MkMNIST_parseImagesFlat_Float32(
+  KL::MkMNIST::INParam expr,
+  KL::String::INParam path,
+  KL::Float64 scale_min,
+  KL::Float64 scale_max,
+  KL::UInt32 x_padding,
+  KL::UInt32 y_padding,
+  KL::VariableArray<KL::Float32>::IOParam images, 
+  KL::Traits< KL::UInt32 >::IOParam width,
+  KL::Traits< KL::UInt32 >::IOParam height) 
+{
+  return MkMNISTParseImagesFlat(path.data(), scale_min, scale_max, x_padding, y_padding, images, width, height);
+}
+
+FABRIC_EXT_EXPORT KL::UInt32 MkMNIST_parseImagesFlat_Float64(
+  KL::MkMNIST::INParam expr,
+  KL::String::INParam path,
+  KL::Float64 scale_min,
+  KL::Float64 scale_max,
+  KL::UInt32 x_padding,
+  KL::UInt32 y_padding,
+  KL::VariableArray<KL::Float64>::IOParam images, 
+  KL::Traits< KL::UInt32 >::IOParam width,
+  KL::Traits< KL::UInt32 >::IOParam height) 
+{
+  return MkMNISTParseImagesFlat(path.data(), scale_min, scale_max, x_padding, y_padding, images, width, height);
+}
+
+/********/
+
+// Binary dataset cache (.mlkb)
+// A header, followed by one contiguous block of normalized images at the precision of the network 
+// (dtype is the size of a value) and one block of UInt32 labels, both aligned on MLKB_ALIGNMENT bytes.
+const uint32_t MLKB_MAGIC = 0x424B4C4D; // "MLKB"
+const uint32_t MLKB_VERSION = 1;
+const uint32_t MLKB_DTYPE_FLOAT32 = 4;
+const uint32_t MLKB_DTYPE_FLOAT64 = 8;
+const uint64_t MLKB_ALIGNMENT = 64;
+
+struct mlkb_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t dtype;
+  uint32_t num_items;
+  uint32_t width;
+  uint32_t height;
+  uint32_t channels;
+  uint32_t x_padding;
+  uint32_t y_padding;
+  uint32_t reserved;
+  double scale_min;
+  double scale_max;
+  uint64_t signature;     // Size and date of the source files
+  uint64_t checksum;      // Hash of the images and labels blocks
+  uint64_t images_offset;
+  uint64_t labels_offset;
+};
+
+inline uint64_t AlignOffset(uint64_t offset) {
+  return (offset + MLKB_ALIGNMENT - 1) / MLKB_ALIGNMENT * MLKB_ALIGNMENT;
+}
+
+/// FNV-1a like hash, computed on 64 bits words
+inline uint64_t HashBlock(const uint8_t *data, size_t size, uint64_t hash) {
+  const uint64_t prime = 0x100000001b3ULL;
+  size_t words = size / 8;
+  for (size_t i = 0; i < words; i++)
+  {
+    uint64_t w;
+    memcpy(&w, data + 8 * i, 8);
+    hash = (hash ^ w) * prime;
+  }
+  for (size_t i = 8 * words; i < size; i++)
+    hash = (hash ^ data[i]) * prime;
+  return hash;
+}
+
+/// Identify the state of the source files, the cache is stale as soon as one changes
+inline uint64_t SourcesSignature(KL::VariableArray<KL::String>::INParam sources) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < sources.size(); i++)
+  {
+    struct stat st;
+    if (stat(sources[i].data(), &st) != 0)
+      return 0;
+    uint64_t values[2] = { uint64_t(st.st_size), uint64_t(st.st_mtime) };
+    hash = HashBlock((const uint8_t *) sources[i].data(), strlen(sources[i].data()), hash);
+    hash = HashBlock((const uint8_t *) values, sizeof(values), hash);
+  }
+  return hash;
+}
+
+/// Load the cache straight at the network precision T, a cache of another precision is rebuilt
+template<typename T> inline KL::Boolean MkDatasetCacheLoad(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::INParam sources,
+  double scale_min,
+  double scale_max,
+  uint32_t x_padding,
+  uint32_t y_padding,
+  KL::VariableArray<T> &images, 
+  KL::VariableArray<KL::UInt32> &labels) 
+{
+  MkMappedFile file(path.data());
+  if (!file.isValid() || file.size() < sizeof(mlkb_header))
+    return false;
+
+  mlkb_header header;
+  memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != MLKB_MAGIC || header.version != MLKB_VERSION || header.dtype != sizeof(T))
+    return false;
+
+  // The cache only holds one normalization, rebuild it if the request differs
+  if (header.scale_min != scale_min || header.scale_max != scale_max ||
+      header.x_padding != x_padding || header.y_padding != y_padding ||
+      header.signature != SourcesSignature(sources))
+    return false;
+
+  const size_t image_size = size_t(header.width) * header.height * header.channels;
+  const size_t images_bytes = size_t(header.num_items) * image_size * sizeof(T);
+  const size_t labels_bytes = size_t(header.num_items) * sizeof(uint32_t);
+  if (header.images_offset + images_bytes > file.size() || header.labels_offset + labels_bytes > file.size())
+  {
+    cerr << "Error MkDatasetCacheLoad : truncated cache " << path.data() << endl;
+    return false;
+  }
+
+  const uint8_t *images_block = file.data() + header.images_offset;
+  const uint8_t *labels_block = file.data() + header.labels_offset;
+  uint64_t checksum = HashBlock(images_block, images_bytes, 0xcbf29ce484222325ULL);
+  checksum = HashBlock(labels_block, labels_bytes, checksum);
+  if (checksum != header.checksum)
+  {
+    cerr << "Error MkDatasetCacheLoad : corrupted cache " << path.data() << endl;
+    return false;
+  }
+
+  // The images block is already laid out as [num_items x image_size] at the network precision,
+  // a single copy moves it out of the mapping
+  images.resize(header.num_items * image_size);
+  memcpy(&images[0], images_block, images_bytes);
+
+  labels.resize(header.num_items);
+  memcpy(&labels[0], labels_block, labels_bytes);
+  return true;
+}
+
+/// Save the images at the network precision T
+template<typename T> inline KL::Boolean MkDatasetCacheSave(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::INParam sources,
+  double scale_min,
+  double scale_max,
+  uint32_t x_padding,
+  uint32_t y_padding,
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  const KL::VariableArray<T> &images, 
+  KL::VariableArray<KL::UInt32>::INParam labels) 
+{
+  const size_t image_size = size_t(width) * height * channels;
+  if (labels.size() == 0)
+    return false;
+  if (images.size() != labels.size() * image_size)
+  {
+    cerr << "Error MkDatasetCacheSave : image size mismatch" << endl;
+    return false;
+  }
+  const size_t images_bytes = images.size() * sizeof(T);
+
+  mlkb_header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = MLKB_MAGIC;
+  header.version = MLKB_VERSION;
+  header.dtype = sizeof(T) == sizeof(float) ? MLKB_DTYPE_FLOAT32 : MLKB_DTYPE_FLOAT64;
+  header.num_items = uint32_t(labels.size());
+  header.width = width;
+  header.height = height;
+  header.channels = channels;
+  header.x_padding = x_padding;
+  header.y_padding = y_padding;
+  header.scale_min = scale_min;
+  header.scale_max = scale_max;
+  header.signature = SourcesSignature(sources);
+  header.images_offset = AlignOffset(sizeof(header));
+  header.labels_offset = AlignOffset(header.images_offset + images_bytes);
+
+  uint64_t checksum = HashBlock((const uint8_t *) &images[0], images_bytes, 0xcbf29ce484222325ULL);
+  header.checksum = HashBlock((const uint8_t *) &labels[0], labels.size() * sizeof(uint32_t), checksum);
+
+  // Write to a temporary file first, synced before it replaces the cache, 
+  // so a crash never leaves a half-written or a missing cache
+  string tmp_path = string(path.data()) + ".tmp";
+  {
+    ofstream ofs(tmp_path.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!ofs.is_open())
+    {
+      cerr << "Error MkDatasetCacheSave : cannot write " << tmp_path << endl;
+      return false;
+    }
+
+    const char zeros[MLKB_ALIGNMENT] = { 0 };
+    ofs.write((const char *) &header, sizeof(header));
+    ofs.write(zeros, header.images_offset - sizeof(header));
+    ofs.write((const char *) &images[0], images_bytes);
+    ofs.write(zeros, header.labels_offset - (header.images_offset + images_bytes));
+    ofs.write((const char *) &labels[0], labels.size() * sizeof(uint32_t));
+    if (ofs.fail())
+      return false;
+  }
+
+  if (!SyncFile(tmp_path))
+  {
+    cerr << "Error MkDatasetCacheSave : cannot sync " << tmp_path << endl;
+    return false;
+  }
+  return AtomicReplace(tmp_path, path.data());
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkDatasetCacheLoad_Float32(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::INParam sources,
+  KL::Float64 scale_min,
+  KL::Float64 scale_max,
+  KL::UInt32 x_padding,
+  KL::UInt32 y_padding,
+  KL::VariableArray<KL::Float32>::IOParam images, 
+  KL::VariableArray<KL::UInt32>::IOParam labels) 
+{
+  return MkDatasetCacheLoad(path, sources, scale_min, scale_max, x_padding, y_padding, images, labels);
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkDatasetCacheLoad_Float64(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::INParam sources,
+  KL::Float64 scale_min,
+  KL::Float64 scale_max,
+  KL::UInt32 x_padding,
+  KL::UInt32 y_padding,
+  KL::VariableArray<KL::Float64>::IOParam images, 
+  KL::VariableArray<KL::UInt32>::IOParam labels) 
+{
+  return MkDatasetCacheLoad(path, sources, scale_min, scale_max, x_padding, y_padding, images, labels);
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkDatasetCacheSave_Float32(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::INParam sources,
+  KL::Float64 scale_min,
+  KL::Float64 scale_max,
+  KL::UInt32 x_padding,
+  KL::UInt32 y_padding,
+  KL::UInt32 width,
+  KL::UInt32 height,
+  KL::UInt32 channels,
+  KL::VariableArray<KL::Float32>::INParam images, 
+  KL::VariableArray<KL::UInt32>::INParam labels) 
+{
+  return MkDatasetCacheSave(path, sources, scale_min, scale_max, x_padding, y_padding, 
+    width, height, channels, images, labels);
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkDatasetCacheSave_Float64(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::INParam sources,
+  KL::Float64 scale_min,
+  KL::Float64 scale_max,
+  KL::UInt32 x_padding,
+  KL::UInt32 y_padding,
+  KL::UInt32 width,
+  KL::UInt32 height,
+  KL::UInt32 channels,
+  KL::VariableArray<KL::Float64>::INParam images, 
+  KL::VariableArray<KL::UInt32>::INParam labels) 
+{
+  return MkDatasetCacheSave(path, sources, scale_min, scale_max, x_padding, y_padding, 
+    width, height, channels, images, labels);
+}
+
+/********/
+
+// Binary checkpoint (.mlkc)
+// A header, a table of the layers then the raw weights and bias blocks, 
+// each block aligned on MLKB_ALIGNMENT bytes so it can be used straight from the mapping.
+// Version 2 appends the training state entries (optimizer, schedule, RNG streams), 
+// always stored in Float64 whatever the precision of the weights.
+const uint32_t MLKC_MAGIC = 0x434B4C4D; // "MLKC"
+const uint32_t MLKC_VERSION = 2;
+const uint32_t MLKC_NAME_SIZE = 64;
+const uint32_t MLKC_MODE_STATE = 0xFFFFFFFF;
+
+struct mlkc_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t dtype;         // Size in bytes of a weight, 4 or 8
+  uint32_t num_layers;
+  uint64_t table_offset;
+  uint64_t file_size;
+  uint64_t checksum;      // Hash of the table and the blocks
+};
+
+struct mlkc_layer {
+  char name[MLKC_NAME_SIZE];
+  uint32_t mode;
+  uint32_t in_size;
+  uint32_t out_size;
+  uint32_t dtype;         // Size in bytes of a value of the entry, 0 for the header dtype (version 1)
+  uint64_t w_offset;
+  uint64_t w_count;
+  uint64_t b_offset;
+  uint64_t b_count;
+};
+
+/// Copy a block of the checkpoint, converting it if the checkpoint has another precision
+template<typename T> inline void ReadCheckpointBlock(
+  const uint8_t *src,
+  uint32_t dtype,
+  uint64_t count,
+  KL::VariableArray<T> &dst)
+{
+  dst.resize(count);
+  if (count == 0)
+    return;
+  if (dtype == sizeof(T))
+    memcpy(&dst[0], src, count * sizeof(T));
+  else if (dtype == sizeof(float))
+    for (uint64_t i = 0; i < count; i++) { float v; memcpy(&v, src + i * sizeof(v), sizeof(v)); dst[i] = T(v); }
+  else
+    for (uint64_t i = 0; i < count; i++) { double v; memcpy(&v, src + i * sizeof(v), sizeof(v)); dst[i] = T(v); }
+}
+
+/// Map a checkpoint and check its header and its checksum
+inline bool OpenCheckpoint(
+  MkMappedFile &file,
+  const char *path,
+  mlkc_header &header,
+  const uint8_t *&table)
+{
+  if (!file.isValid() || file.size() < sizeof(mlkc_header))
+  {
+    cerr << "Error MkCheckpointLoad : cannot read " << path << endl;
+    return false;
+  }
+
+  memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != MLKC_MAGIC || header.version < 1 || header.version > MLKC_VERSION || 
+      (header.dtype != sizeof(float) && header.dtype != sizeof(double)))
+  {
+    cerr << "Error MkCheckpointLoad : " << path << " is not a checkpoint" << endl;
+    return false;
+  }
+
+  const uint64_t table_size = uint64_t(header.num_layers) * sizeof(mlkc_layer);
+  if (header.file_size != file.size() || header.table_offset + table_size > file.size())
+  {
+    cerr << "Error MkCheckpointLoad : truncated checkpoint " << path << endl;
+    return false;
+  }
+
+  table = file.data() + header.table_offset;
+  if (HashBlock(table, file.size() - header.table_offset, 0xcbf29ce484222325ULL) != header.checksum)
+  {
+    cerr << "Error MkCheckpointLoad : corrupted checkpoint " << path << endl;
+    return false;
+  }
+  return true;
+}
+
+/// Read the l-th entry of the table, check its blocks are in the file
+inline bool ReadCheckpointEntry(
+  const MkMappedFile &file,
+  const char *path,
+  const mlkc_header &header,
+  const uint8_t *table,
+  uint32_t l,
+  mlkc_layer &layer)
+{
+  memcpy(&layer, table + l * sizeof(mlkc_layer), sizeof(layer));
+  layer.name[MLKC_NAME_SIZE - 1] = 0;
+  if (header.version < 2 || layer.dtype == 0)
+    layer.dtype = header.dtype;
+  if ((layer.dtype != sizeof(float) && layer.dtype != sizeof(double)) ||
+      layer.w_offset + layer.w_count * layer.dtype > file.size() || 
+      layer.b_offset + layer.b_count * layer.dtype > file.size())
+  {
+    cerr << "Error MkCheckpointLoad : truncated checkpoint " << path << endl;
+    return false;
+  }
+  return true;
+}
+
+/// Load the layers of the checkpoint, the training state entries are skipped
+template<typename T> inline KL::Boolean MkCheckpointLoad(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::IOParam names,
+  KL::VariableArray<KL::UInt32>::IOParam modes,
+  KL::VariableArray<KL::UInt32>::IOParam in_sizes,
+  KL::VariableArray<KL::UInt32>::IOParam out_sizes,
+  KL::VariableArray<KL::VariableArray<T> > &w,
+  KL::VariableArray<KL::VariableArray<T> > &b)
+{
+  MkMappedFile file(path.data());
+  mlkc_header header;
+  const uint8_t *table = 0;
+  if (!OpenCheckpoint(file, path.data(), header, table))
+    return false;
+
+  names.resize(0);
+  modes.resize(0);
+  in_sizes.resize(0);
+  out_sizes.resize(0);
+  w.resize(0);
+  b.resize(0);
+  for (uint32_t l = 0; l < header.num_layers; l++)
+  {
+    mlkc_layer layer;
+    if (!ReadCheckpointEntry(file, path.data(), header, table, l, layer))
+      return false;
+    if (layer.mode == MLKC_MODE_STATE)
+      continue;
+
+    const size_t i = names.size();
+    names.resize(i + 1);
+    modes.resize(i + 1);
+    in_sizes.resize(i + 1);
+    out_sizes.resize(i + 1);
+    w.resize(i + 1);
+    b.resize(i + 1);
+    names[i] = KL::String(layer.name);
+    modes[i] = layer.mode;
+    in_sizes[i] = layer.in_size;
+    out_sizes[i] = layer.out_size;
+    ReadCheckpointBlock(file.data() + layer.w_offset, layer.dtype, layer.w_count, w[i]);
+    ReadCheckpointBlock(file.data() + layer.b_offset, layer.dtype, layer.b_count, b[i]);
+  }
+  return true;
+}
+
+/// Load the training state entries of the checkpoint, none for a version 1 checkpoint
+FABRIC_EXT_EXPORT KL::Boolean MkCheckpointLoadState(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::IOParam names,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::IOParam state)
+{
+  MkMappedFile file(path.data());
+  mlkc_header header;
+  const uint8_t *table = 0;
+  if (!OpenCheckpoint(file, path.data(), header, table))
+    return false;
+
+  names.resize(0);
+  state.resize(0);
+  for (uint32_t l = 0; l < header.num_layers; l++)
+  {
+    mlkc_layer layer;
+    if (!ReadCheckpointEntry(file, path.data(), header, table, l, layer))
+      return false;
+    if (layer.mode != MLKC_MODE_STATE)
+      continue;
+
+    const size_t i = names.size();
+    names.resize(i + 1);
+    state.resize(i + 1);
+    names[i] = KL::String(layer.name);
+    ReadCheckpointBlock(file.data() + layer.w_offset, layer.dtype, layer.w_count, state[i]);
+  }
+  return true;
+}
+
+/// Serialize the layers and the training state in image, the whole checkpoint file
+/// This is the snapshot of the weights, the KL arrays aren't read anymore afterwards
+template<typename T> inline bool BuildCheckpoint(
+  KL::VariableArray<KL::String>::INParam names,
+  KL::VariableArray<KL::UInt32>::INParam modes,
+  KL::VariableArray<KL::UInt32>::INParam in_sizes,
+  KL::VariableArray<KL::UInt32>::INParam out_sizes,
+  const KL::VariableArray<KL::VariableArray<T> > &w,
+  const KL::VariableArray<KL::VariableArray<T> > &b,
+  KL::VariableArray<KL::String>::INParam state_names,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam state,
+  vector<uint8_t> &image)
+{
+  const size_t num_layers = names.size();
+  const size_t num_states = state_names.size();
+  if (modes.size() != num_layers || in_sizes.size() != num_layers || out_sizes.size() != num_layers ||
+      w.size() != num_layers || b.size() != num_layers || state.size() != num_states)
+  {
+    cerr << "Error MkCheckpointSave : layer table size mismatch" << endl;
+    return false;
+  }
+
+  mlkc_header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = MLKC_MAGIC;
+  header.version = MLKC_VERSION;
+  header.dtype = sizeof(T);
+  header.num_layers = uint32_t(num_layers + num_states);
+  header.table_offset = AlignOffset(sizeof(header));
+
+  vector<mlkc_layer> table(num_layers + num_states);
+  uint64_t offset = AlignOffset(header.table_offset + table.size() * sizeof(mlkc_layer));
+  for (size_t l = 0; l < num_layers; l++)
+  {
+    mlkc_layer &layer = table[l];
+    memset(&layer, 0, sizeof(layer));
+    strncpy(layer.name, names[l].data() ? names[l].data() : "", MLKC_NAME_SIZE - 1);
+    layer.mode = modes[l];
+    layer.in_size = in_sizes[l];
+    layer.out_size = out_sizes[l];
+    layer.dtype = sizeof(T);
+    layer.w_offset = offset;
+    layer.w_count = w[l].size();
+    offset = AlignOffset(offset + layer.w_count * sizeof(T));
+    layer.b_offset = offset;
+    layer.b_count = b[l].size();
+    offset = AlignOffset(offset + layer.b_count * sizeof(T));
+  }
+  for (size_t s = 0; s < num_states; s++)
+  {
+    mlkc_layer &layer = table[num_layers + s];
+    memset(&layer, 0, sizeof(layer));
+    strncpy(layer.name, state_names[s].data() ? state_names[s].data() : "", MLKC_NAME_SIZE - 1);
+    layer.mode = MLKC_MODE_STATE;
+    layer.dtype = sizeof(double);
+    layer.w_offset = offset;
+    layer.w_count = state[s].size();
+    offset = AlignOffset(offset + layer.w_count * sizeof(double));
+    layer.b_offset = offset;
+  }
+  header.file_size = offset;
+
+  // The padding stays zeroed, the checksum covers everything after the header
+  image.assign(size_t(header.file_size), 0);
+  if (!table.empty())
+    memcpy(&image[size_t(header.table_offset)], &table[0], table.size() * sizeof(mlkc_layer));
+  for (size_t l = 0; l < num_layers; l++)
+  {
+    if (table[l].w_count > 0)
+      memcpy(&image[size_t(table[l].w_offset)], &w[l][0], size_t(table[l].w_count) * sizeof(T));
+    if (table[l].b_count > 0)
+      memcpy(&image[size_t(table[l].b_offset)], &b[l][0], size_t(table[l].b_count) * sizeof(T));
+  }
+  for (size_t s = 0; s < num_states; s++)
+  {
+    const mlkc_layer &layer = table[num_layers + s];
+    if (layer.w_count > 0)
+      memcpy(&image[size_t(layer.w_offset)], &state[s][0], size_t(layer.w_count) * sizeof(double));
+  }
+  header.checksum = HashBlock(&image[0] + header.table_offset, image.size() - header.table_offset, 0xcbf29ce484222325ULL);
+  memcpy(&image[0], &header, sizeof(header));
+  return true;
+}
+
+/// Path of the k-th previous checkpoint, res.mlkc . res.k.mlkc
+inline string RotatedPath(const string &path, size_t k) {
+  string index = "." + to_string((unsigned long long) k);
+  size_t dot = path.find_last_of('.');
+  size_t slash = path.find_last_of("/\\");
+  if (dot == string::npos || (slash != string::npos && dot < slash))
+    return path + index;
+  return path.substr(0, dot) + index + path.substr(dot);
+}
+
+/// Write a checkpoint image to a synced temporary file then rename it over path, so a crash 
+/// never leaves a half-written or a missing checkpoint. The keep - 1 previous ones are kept as res.k.mlkc
+inline bool WriteCheckpoint(const string &path, const vector<uint8_t> &image, size_t keep) {
+  string tmp_path = path + ".tmp";
+  {
+    ofstream ofs(tmp_path.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!ofs.is_open())
+    {
+      cerr << "Error MkCheckpointSave : cannot write " << tmp_path << endl;
+      return false;
+    }
+    if (!image.empty())
+      ofs.write((const char *) &image[0], image.size());
+    if (ofs.fail())
+    {
+      cerr << "Error MkCheckpointSave : cannot write " << tmp_path << endl;
+      return false;
+    }
+  }
+  if (!SyncFile(tmp_path))
+  {
+    cerr << "Error MkCheckpointSave : cannot sync " << tmp_path << endl;
+    return false;
+  }
+
+  // Shift the previous checkpoints, each rename replaces the next one so the oldest is dropped.
+  // The current checkpoint is linked as res.1.mlkc, path stays in place until it is replaced
+  if (keep > 1)
+  {
+    for (size_t k = keep - 1; k > 1; k--)
+      AtomicReplace(RotatedPath(path, k - 1), RotatedPath(path, k));
+    string previous = RotatedPath(path, 1);
+    remove(previous.c_str());
+    ifstream current(path.c_str());
+    if (current.is_open())
+    {
+      current.close();
+      LinkOrCopy(path, previous);
+    }
+  }
+  if (!AtomicReplace(tmp_path, path))
+  {
+    cerr << "Error MkCheckpointSave : cannot rename " << tmp_path << endl;
+    return false;
+  }
+  return true;
+}
+
+template<typename T> inline KL::Boolean MkCheckpointSave(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::INParam names,
+  KL::VariableArray<KL::UInt32>::INParam modes,
+  KL::VariableArray<KL::UInt32>::INParam in_sizes,
+  KL::VariableArray<KL::UInt32>::INParam out_sizes,
+  const KL::VariableArray<KL::VariableArray<T> > &w,
+  const KL::VariableArray<KL::VariableArray<T> > &b,
+  KL::VariableArray<KL::String>::INParam state_names,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam state)
+{
+  vector<uint8_t> image;
+  if (!BuildCheckpoint(names, modes, in_sizes, out_sizes, w, b, state_names, state, image))
+    return false;
+  return WriteCheckpoint(path.data(), image, 1);
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkCheckpointLoad_Float32(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::IOParam names,
+  KL::VariableArray<KL::UInt32>::IOParam modes,
+  KL::VariableArray<KL::UInt32>::IOParam in_sizes,
+  KL::VariableArray<KL::UInt32>::IOParam out_sizes,
+  KL::VariableArray<KL::VariableArray<KL::Float32> >::IOParam w,
+  KL::VariableArray<KL::VariableArray<KL::Float32> >::IOParam b)
+{
+  return MkCheckpointLoad(path, names, modes, in_sizes, out_sizes, w, b);
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkCheckpointLoad_Float64(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::IOParam names,
+  KL::VariableArray<KL::UInt32>::IOParam modes,
+  KL::VariableArray<KL::UInt32>::IOParam in_sizes,
+  KL::VariableArray<KL::UInt32>::IOParam out_sizes,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::IOParam w,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::IOParam b)
+{
+  return MkCheckpointLoad(path, names, modes, in_sizes, out_sizes, w, b);
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkCheckpointSave_Float32(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::INParam names,
+  KL::VariableArray<KL::UInt32>::INParam modes,
+  KL::VariableArray<KL::UInt32>::INParam in_sizes,
+  KL::VariableArray<KL::UInt32>::INParam out_sizes,
+  KL::VariableArray<KL::VariableArray<KL::Float32> >::INParam w,
+  KL::VariableArray<KL::VariableArray<KL::Float32> >::INParam b,
+  KL::VariableArray<KL::String>::INParam state_names,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam state)
+{
+  return MkCheckpointSave(path, names, modes, in_sizes, out_sizes, w, b, state_names, state);
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkCheckpointSave_Float64(
+  KL::String::INParam path,
+  KL::VariableArray<KL::String>::INParam names,
+  KL::VariableArray<KL::UInt32>::INParam modes,
+  KL::VariableArray<KL::UInt32>::INParam in_sizes,
+  KL::VariableArray<KL::UInt32>::INParam out_sizes,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam w,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam b,
+  KL::VariableArray<KL::String>::INParam state_names,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam state)
+{
+  return MkCheckpointSave(path, names, modes, in_sizes, out_sizes, w, b, state_names, state);
+}
+
+/// Background checkpoint writer
+/// submit() only serializes the weights in a staging image, a thread writes it to the disk.
+/// A single image waits behind the one being written, a newer submit replaces it.
+class MkCheckpointWriterEngine {
+public:
+  MkCheckpointWriterEngine()
+    : m_stop(false), m_pending(false), m_busy(false), m_pending_keep(1), 
+      m_written(0), m_dropped(0), m_failed(0)
+  {
+    m_worker = thread(&MkCheckpointWriterEngine::workerLoop, this);
+  }
+
+  /// The last submitted checkpoint is written before leaving
+  ~MkCheckpointWriterEngine() {
+    {
+      unique_lock<mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_work.notify_all();
+    m_worker.join();
+  }
+
+  template<typename T> bool submit(
+    KL::String::INParam path,
+    size_t keep,
+    KL::VariableArray<KL::String>::INParam names,
+    KL::VariableArray<KL::UInt32>::INParam modes,
+    KL::VariableArray<KL::UInt32>::INParam in_sizes,
+    KL::VariableArray<KL::UInt32>::INParam out_sizes,
+    const KL::VariableArray<KL::VariableArray<T> > &w,
+    const KL::VariableArray<KL::VariableArray<T> > &b,
+    KL::VariableArray<KL::String>::INParam state_names,
+    KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam state)
+  {
+    // The staging image is built out of the lock, the thread may be writing the previous one
+    vector<uint8_t> image;
+    if (!BuildCheckpoint(names, modes, in_sizes, out_sizes, w, b, state_names, state, image))
+      return false;
+
+    unique_lock<mutex> lock(m_mutex);
+    if (m_pending)
+      m_dropped++;
+    m_pending = true;
+    m_pending_path = path.data();
+    m_pending_keep = max(size_t(1), keep);
+    m_pending_image.swap(image);
+    lock.unlock();
+    m_work.notify_all();
+    return true;
+  }
+
+  /// Wait until the submitted checkpoints are written, return false if a write failed since the last wait
+  bool wait() {
+    unique_lock<mutex> lock(m_mutex);
+    while (m_pending || m_busy)
+      m_idle.wait(lock);
+    bool success = (m_failed == 0);
+    m_failed = 0;
+    return success;
+  }
+
+  size_t written() { unique_lock<mutex> lock(m_mutex); return m_written; }
+  size_t dropped() { unique_lock<mutex> lock(m_mutex); return m_dropped; }
+
+private:
+  void workerLoop() {
+    vector<uint8_t> image;
+    unique_lock<mutex> lock(m_mutex);
+    for (;;)
+    {
+      while (!m_pending && !m_stop)
+        m_work.wait(lock);
+      if (!m_pending)
+        return;
+
+      string path = m_pending_path;
+      size_t keep = m_pending_keep;
+      image.swap(m_pending_image);
+      m_pending = false;
+      m_busy = true;
+      lock.unlock();
+
+      bool success = WriteCheckpoint(path, image, keep);
+
+      lock.lock();
+      m_busy = false;
+      if (success)
+        m_written++;
+      else
+        m_failed++;
+      m_idle.notify_all();
+    }
+  }
+
+  thread m_worker;
+  mutex m_mutex;
+  condition_variable m_work;
+  condition_variable m_idle;
+  bool m_stop;
+  bool m_pending;
+  bool m_busy;
+  string m_pending_path;
+  size_t m_pending_keep;
+  vector<uint8_t> m_pending_image;
+  size_t m_written;
+  size_t m_dropped;
+  size_t m_failed;
+};
+
+inline MkCheckpointWriterEngine *GetCheckpointWriter(KL::MkCheckpointWriter::INParam this_) {
+  return (MkCheckpointWriterEngine *) this_->handle;
+}
+
+FABRIC_EXT_EXPORT void MkCheckpointWriter_init(
+  KL::MkCheckpointWriter::IOParam this_)
+{
+  delete GetCheckpointWriter(this_);
+  this_->handle = new MkCheckpointWriterEngine();
+}
+
+FABRIC_EXT_EXPORT void MkCheckpointWriter_destroy(
+  KL::MkCheckpointWriter::IOParam this_)
+{
+  delete GetCheckpointWriter(this_);
+  this_->handle = 0;
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkCheckpointWriter_submit_Float32(
+  KL::MkCheckpointWriter::IOParam this_,
+  KL::String::INParam path,
+  KL::UInt32 keep,
+  KL::VariableArray<KL::String>::INParam names,
+  KL::VariableArray<KL::UInt32>::INParam modes,
+  KL::VariableArray<KL::UInt32>::INParam in_sizes,
+  KL::VariableArray<KL::UInt32>::INParam out_sizes,
+  KL::VariableArray<KL::VariableArray<KL::Float32> >::INParam w,
+  KL::VariableArray<KL::VariableArray<KL::Float32> >::INParam b,
+  KL::VariableArray<KL::String>::INParam state_names,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam state)
+{
+  MkCheckpointWriterEngine *writer = GetCheckpointWriter(this_);
+  return writer ? writer->submit(path, keep, names, modes, in_sizes, out_sizes, w, b, state_names, state) : false;
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkCheckpointWriter_submit_Float64(
+  KL::MkCheckpointWriter::IOParam this_,
+  KL::String::INParam path,
+  KL::UInt32 keep,
+  KL::VariableArray<KL::String>::INParam names,
+  KL::VariableArray<KL::UInt32>::INParam modes,
+  KL::VariableArray<KL::UInt32>::INParam in_sizes,
+  KL::VariableArray<KL::UInt32>::INParam out_sizes,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam w,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam b,
+  KL::VariableArray<KL::String>::INParam state_names,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::INParam state)
+{
+  MkCheckpointWriterEngine *writer = GetCheckpointWriter(this_);
+  return writer ? writer->submit(path, keep, names, modes, in_sizes, out_sizes, w, b, state_names, state) : false;
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkCheckpointWriter_wait(
+  KL::MkCheckpointWriter::IOParam this_)
+{
+  MkCheckpointWriterEngine *writer = GetCheckpointWriter(this_);
+  return writer ? writer->wait() : false;
+}
+
+FABRIC_EXT_EXPORT KL::UInt32 MkCheckpointWriter_written(
+  KL::MkCheckpointWriter::INParam this_)
+{
+  MkCheckpointWriterEngine *writer = GetCheckpointWriter(this_);
+  return writer ? KL::UInt32(writer->written()) : 0;
+}
+
+FABRIC_EXT_EXPORT KL::UInt32 MkCheckpointWriter_dropped(
+  KL::MkCheckpointWriter::INParam this_)
+{
+  MkCheckpointWriterEngine *writer = GetCheckpointWriter(this_);
+  return writer ? KL::UInt32(writer->dropped()) : 0;
 }
 
 /********/
 
-template<typename T> inline 
-typename enable_if<is_integral<T>::value, T>::type UniformRand(T min, T max) {
-  static mt19937 gen(1);
-  uniform_int_distribution<T> dst(min, max);
-  return dst(gen);
+
+// Default stream used by the scalar functions below, each call reserves 
+// its own counters so they can safely be called from parallel operators.
+static const MkPhilox s_default_gen(1, 0);
+static atomic<uint64_t> s_default_counter(0);
+
+inline uint64_t ReserveBlocks(size_t size) {
+  return s_default_counter.fetch_add((size + 3) / 4);
 }
 
-template<typename T> inline 
-typename enable_if<is_floating_point<T>::value, T>::type UniformRand(T min, T max) {
-  static mt19937 gen(1);
-  uniform_real_distribution<T> dst(min, max);
-  return dst(gen);
+template<typename T> inline T UniformRand(T min, T max) {
+  T val;
+  PhiloxFill(s_default_gen, ReserveBlocks(1), &val, 1, min, max);
+  return val;
 }
 
 template<typename T> void UniformRand(T *val, int size, T min, T max) {
-  for (int i=0; i<size; ++i) 
-    val[i] = UniformRand(min, max);
+  PhiloxFill(s_default_gen, ReserveBlocks(size), val, size, min, max);
 }
  
 FABRIC_EXT_EXPORT void UniformRand_Float64( 
@@ -267,6 +1343,98 @@ FABRIC_EXT_EXPORT void Bernoulli_Float32_UInt32(
   res = KL::UInt32(UniformRand(0.0f, 1.0f) <= float(p));
 }
  
+FABRIC_EXT_EXPORT void MkRandomUniform_Float64( 
+  KL::Traits< KL::UInt32 >::INParam seed, 
+  KL::Traits< KL::UInt32 >::INParam stream, 
+  KL::Traits< KL::UInt64 >::IOParam counter, 
+  KL::Traits< KL::Float64 >::INParam min, 
+  KL::Traits< KL::Float64 >::INParam max,
+  KL::Traits< KL::VariableArray<KL::Float64>>::IOParam dist)
+{
+  if (dist.size() == 0) return;
+  counter = PhiloxFill(MkPhilox(seed, stream), counter, &dist[0], dist.size(), double(min), double(max));
+}
+
+FABRIC_EXT_EXPORT void MkRandomUniform_Float32( 
+  KL::Traits< KL::UInt32 >::INParam seed, 
+  KL::Traits< KL::UInt32 >::INParam stream, 
+  KL::Traits< KL::UInt64 >::IOParam counter, 
+  KL::Traits< KL::Float32 >::INParam min, 
+  KL::Traits< KL::Float32 >::INParam max,
+  KL::Traits< KL::VariableArray<KL::Float32>>::IOParam dist)
+{
+  if (dist.size() == 0) return;
+  counter = PhiloxFill(MkPhilox(seed, stream), counter, &dist[0], dist.size(), float(min), float(max));
+}
+
+FABRIC_EXT_EXPORT void MkRandomUniform_UInt32( 
+  KL::Traits< KL::UInt32 >::INParam seed, 
+  KL::Traits< KL::UInt32 >::INParam stream, 
+  KL::Traits< KL::UInt64 >::IOParam counter, 
+  KL::Traits< KL::UInt32 >::INParam min, 
+  KL::Traits< KL::UInt32 >::INParam max,
+  KL::Traits< KL::VariableArray<KL::UInt32>>::IOParam dist)
+{
+  if (dist.size() == 0) return;
+  counter = PhiloxFill(MkPhilox(seed, stream), counter, &dist[0], dist.size(), uint32_t(min), uint32_t(max));
+}
+
+FABRIC_EXT_EXPORT void MkRandomBernoulli_UInt32( 
+  KL::Traits< KL::UInt32 >::INParam seed, 
+  KL::Traits< KL::UInt32 >::INParam stream, 
+  KL::Traits< KL::UInt64 >::IOParam counter, 
+  KL::Traits< KL::Float64 >::INParam p, 
+  KL::Traits< KL::VariableArray<KL::UInt32>>::IOParam mask)
+{
+  if (mask.size() == 0) return;
+  counter = PhiloxBernoulli(MkPhilox(seed, stream), counter, &mask[0], mask.size(), double(p));
+}
+
+FABRIC_EXT_EXPORT void MkRandomBernoulli_Float64( 
+  KL::Traits< KL::UInt32 >::INParam seed, 
+  KL::Traits< KL::UInt32 >::INParam stream, 
+  KL::Traits< KL::UInt64 >::IOParam counter, 
+  KL::Traits< KL::Float64 >::INParam p, 
+  KL::Traits< KL::VariableArray<KL::Float64>>::IOParam mask)
+{
+  if (mask.size() == 0) return;
+  counter = PhiloxBernoulli(MkPhilox(seed, stream), counter, &mask[0], mask.size(), double(p));
+}
+
+FABRIC_EXT_EXPORT void MkRandomBernoulli_Float32( 
+  KL::Traits< KL::UInt32 >::INParam seed, 
+  KL::Traits< KL::UInt32 >::INParam stream, 
+  KL::Traits< KL::UInt64 >::IOParam counter, 
+  KL::Traits< KL::Float64 >::INParam p, 
+  KL::Traits< KL::VariableArray<KL::Float32>>::IOParam mask)
+{
+  if (mask.size() == 0) return;
+  counter = PhiloxBernoulli(MkPhilox(seed, stream), counter, &mask[0], mask.size(), double(p));
+}
+
+/// Packed variant, bit i of bits[i/32] is set with probability p
+FABRIC_EXT_EXPORT void MkRandomBernoulliBits( 
+  KL::Traits< KL::UInt32 >::INParam seed, 
+  KL::Traits< KL::UInt32 >::INParam stream, 
+  KL::Traits< KL::UInt64 >::IOParam counter, 
+  KL::Traits< KL::Float64 >::INParam p, 
+  KL::Traits< KL::UInt32 >::INParam size, 
+  KL::Traits< KL::VariableArray<KL::UInt32>>::IOParam bits)
+{
+  bits.resize((size + 31) / 32);
+  if (bits.size() == 0) return;
+
+  vector<uint8_t> mask(bits.size() * 32, 0);
+  counter = PhiloxBernoulli(MkPhilox(seed, stream), counter, &mask[0], size, double(p));
+  for (size_t w = 0; w < bits.size(); w++)
+  {
+    uint32_t word = 0;
+    for (size_t b = 0; b < 32; b++)
+      word |= uint32_t(mask[32*w + b]) << b;
+    bits[w] = word;
+  }
+}
+
 FABRIC_EXT_EXPORT void ReportR(KL::Traits< KL::String >::INParam str) {
   cerr << string(str.data()) << "\r";
 }
@@ -0,0 +1,667 @@
+/**************************************************************************************************/
+/*                                                                                                */
+/*  Informations :                                                                                */
+/*      This code is part of the project MLKL                                                     */
+/*                                                                                                */
+/*  Contacts :                                                                                    */
+/*      couet.julien@gmail.com                                                                    */
+/*                                                                                                */
+/**************************************************************************************************/
+
+#include <cmath>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <string.h>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+using namespace std;
+
+#include <MkPhilox.h>
+#include <MkAugment.h>
+#include <FabricEDK.h>
+using namespace Fabric::EDK;
+
+IMPLEMENT_FABRIC_EDK_ENTRIES( MkAugment )
+
+
+/// Augmentation parameters, a zero value disables the transformation
+struct MkAugmentParams {
+  uint32_t max_shift;       // Maximal translation in pixels, should stay within the padding
+  bool flip;                // Random horizontal flips (CIFAR), not for digits
+  double max_rotation;      // Maximal rotation in radians
+  double max_scale;         // Maximal relative scaling
+  double elastic;           // Maximal elastic displacement in pixels
+
+  MkAugmentParams() : max_shift(0), flip(false), max_rotation(0.0), max_scale(0.0), elastic(0.0) {}
+
+  bool isIdentity() const {
+    return max_shift == 0 && !flip && max_rotation == 0.0 && max_scale == 0.0 && elastic == 0.0;
+  }
+};
+
+// Elastic displacements are drawn on a coarse grid and interpolated
+const size_t ELASTIC_GRID = 4;
+const size_t ELASTIC_VALUES = 2 * ELASTIC_GRID * ELASTIC_GRID;
+// Random blocks used per sample : 1 block for the affine part, 1 for the flip, the rest for the elastic grid
+// Each parameter draws from its own words, so they are independent
+const size_t BLOCKS_PER_SAMPLE = 2 + ELASTIC_VALUES / 4;
+
+/// Bilinear sampling of a planar channel, background outside the image
+template<typename T> inline double Sample(
+  const T *src,
+  size_t width,
+  size_t height,
+  double x,
+  double y,
+  double background)
+{
+  if (x <= -1.0 || y <= -1.0 || x >= double(width) || y >= double(height))
+    return background;
+
+  int x0 = int(floor(x)), y0 = int(floor(y));
+  double fx = x - x0, fy = y - y0;
+  double v[4];
+  for (int k = 0; k < 4; k++)
+  {
+    int xi = x0 + (k & 1), yi = y0 + (k >> 1);
+    v[k] = (xi < 0 || yi < 0 || xi >= int(width) || yi >= int(height)) ? background : src[yi * width + xi];
+  }
+  return (v[0] * (1.0 - fx) + v[1] * fx) * (1.0 - fy) + (v[2] * (1.0 - fx) + v[3] * fx) * fy;
+}
+
+/// Apply a random transformation to one (planar) image, T is the precision of the network
+/// The transformation only depends on (gen, counter), not on the thread running it
+template<typename T> void AugmentImage(
+  const T *src,
+  T *dst,
+  size_t width,
+  size_t height,
+  size_t channels,
+  double background,
+  const MkAugmentParams &params,
+  const MkPhilox &gen,
+  uint64_t counter)
+{
+  const size_t plane = width * height;
+  if (params.isIdentity())
+  {
+    memcpy(dst, src, plane * channels * sizeof(T));
+    return;
+  }
+
+  uint32_t words[4];
+  gen.block(counter, words);
+  double r[4];
+  for (int k = 0; k < 4; k++)
+    r[k] = FromWord(words[k], -1.0, 1.0);
+
+  // Integer translation (random crop within the padding)
+  int shift = int(params.max_shift);
+  int tx = FromWord(words[0], -shift, shift);
+  int ty = FromWord(words[1], -shift, shift);
+  double angle = params.max_rotation * r[2];
+  double scale = 1.0 + params.max_scale * r[3];
+
+  // The flip has its own block, the angle already uses all the bits of words[2]
+  bool flip = false;
+  if (params.flip)
+  {
+    uint32_t flip_words[4];
+    gen.block(counter + 1, flip_words);
+    flip = (flip_words[0] & 0x80000000u) != 0;
+  }
+
+  double elastic[ELASTIC_VALUES];
+  if (params.elastic > 0.0)
+    PhiloxFill(gen, counter + 2, elastic, ELASTIC_VALUES, -params.elastic, params.elastic);
+
+  const double cx = 0.5 * (width - 1), cy = 0.5 * (height - 1);
+  const double ca = cos(angle) / scale, sa = sin(angle) / scale;
+  const bool integer_only = angle == 0.0 && scale == 1.0 && params.elastic == 0.0;
+
+  for (size_t y = 0; y < height; y++)
+  {
+    for (size_t x = 0; x < width; x++)
+    {
+      double u = (flip ? double(width - 1 - x) : double(x)) - cx;
+      double v = double(y) - cy;
+      double sx = ca * u + sa * v + cx - tx;
+      double sy = -sa * u + ca * v + cy - ty;
+
+      if (params.elastic > 0.0)
+      {
+        // Bilinear interpolation of the coarse displacement grid
+        double gx = double(x) * (ELASTIC_GRID - 1) / double(max(width - 1, size_t(1)));
+        double gy = double(y) * (ELASTIC_GRID - 1) / double(max(height - 1, size_t(1)));
+        size_t ix = min(size_t(gx), ELASTIC_GRID - 2), iy = min(size_t(gy), ELASTIC_GRID - 2);
+        double fx = gx - ix, fy = gy - iy;
+        for (size_t d = 0; d < 2; d++)
+        {
+          const double *g = elastic + d * ELASTIC_GRID * ELASTIC_GRID;
+          double e = (g[iy * ELASTIC_GRID + ix] * (1.0 - fx) + g[iy * ELASTIC_GRID + ix + 1] * fx) * (1.0 - fy)
+            + (g[(iy + 1) * ELASTIC_GRID + ix] * (1.0 - fx) + g[(iy + 1) * ELASTIC_GRID + ix + 1] * fx) * fy;
+          if (d == 0) sx += e; else sy += e;
+        }
+      }
+
+      for (size_t c = 0; c < channels; c++)
+      {
+        const T *src_plane = src + c * plane;
+        if (integer_only)
+        {
+          int xi = int(sx + 0.5), yi = int(sy + 0.5);
+          bool inside = sx > -0.5 && sy > -0.5 && xi < int(width) && yi < int(height);
+          dst[c * plane + y * width + x] = inside ? src_plane[yi * width + xi] : T(background);
+        }
+        else
+          dst[c * plane + y * width + x] = T(Sample(src_plane, width, height, sx, sy, background));
+      }
+    }
+  }
+}
+
+/// Images and batch slots stored at the precision T of the network
+template<typename T> struct MkBatchData {
+  vector<T> images;             // [count x image_size]
+  vector<vector<T> > inputs;    // Per slot, [batch_size x image_size]
+  vector<vector<T> > targets;   // Per slot, [batch_size x num_outputs]
+
+  void clear() {
+    images.clear();
+    inputs.clear();
+    targets.clear();
+  }
+};
+
+/// Shuffled minibatch producer
+/// Worker threads gather (and augment) whole batches ahead of the training loop into a ring of
+/// contiguous, preallocated slots. The indices are reshuffled at each epoch, the order only depends
+/// on (seed, epoch) so a run can be replayed or resumed from any epoch.
+/// The dataset and the slots keep the precision of the dataset, the one of the network.
+class MkBatchProducerEngine {
+public:
+  MkBatchProducerEngine(size_t num_workers)
+    : m_float(false), m_width(0), m_height(0), m_channels(0), m_image_size(0), m_background(0.0),
+      m_num_outputs(0), m_target_min(0.0), m_target_max(1.0),
+      m_batch_size(0), m_depth(0), m_batches_per_epoch(0), m_seed(0),
+      m_stop(false), m_running(false), m_active(0), m_next(0), m_consumed(0)
+  {
+    m_perm_epoch[0] = m_perm_epoch[1] = uint64_t(-1);
+    num_workers = max(size_t(1), num_workers);
+    for (size_t t = 0; t < num_workers; t++)
+      m_workers.push_back(thread(&MkBatchProducerEngine::workerLoop, this));
+  }
+
+  ~MkBatchProducerEngine() {
+    {
+      unique_lock<mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_work.notify_all();
+    for (size_t t = 0; t < m_workers.size(); t++)
+      m_workers[t].join();
+  }
+
+  /// Keep a copy of the dataset [num_images x image_size], the workers never touch KL memory
+  /// T is the precision of the network (Float32 or Float64) 
+  template<typename T> bool setDataset(
+    const KL::VariableArray<T> &images,
+    KL::VariableArray<KL::UInt32>::INParam labels,
+    size_t width,
+    size_t height,
+    size_t channels,
+    double background)
+  {
+    pause();
+    m_single.clear();
+    m_double.clear();
+    m_labels.clear();
+    const size_t image_size = width * height * channels;
+    if (images.size() != labels.size() * image_size)
+    {
+      cerr << "Error MkBatchProducer : " << images.size() << " values for " << labels.size() 
+        << " images of size " << image_size << endl;
+      return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_channels = channels;
+    m_background = background;
+    m_image_size = image_size;
+    m_float = sizeof(T) == sizeof(float);
+    vector<T> &dataset = data((T *) 0).images;
+    dataset.resize(images.size());
+    m_labels.resize(labels.size());
+    if (images.size() > 0)
+      memcpy(&dataset[0], &images[0], images.size() * sizeof(T));
+    for (size_t i = 0; i < labels.size(); i++)
+      m_labels[i] = labels[i];
+    return true;
+  }
+
+  /// One-hot targets : target_max for the label output, target_min elsewhere
+  bool setTargets(size_t num_outputs, double target_min, double target_max) {
+    pause();
+    for (size_t i = 0; i < m_labels.size(); i++)
+    {
+      if (m_labels[i] >= num_outputs)
+      {
+        cerr << "Error MkBatchProducer : label " << m_labels[i] << " out of range" << endl;
+        return false;
+      }
+    }
+    m_num_outputs = num_outputs;
+    m_target_min = target_min;
+    m_target_max = target_max;
+    return true;
+  }
+
+  void setParams(const MkAugmentParams &params) {
+    pause();
+    m_params = params;
+  }
+
+  size_t count() const {
+    return m_labels.size();
+  }
+
+  size_t batchesPerEpoch() const {
+    return m_batches_per_epoch;
+  }
+
+  /// (Re)start producing batches from the batch first_batch of first_epoch
+  /// A batch only depends on the seed and its index, so a resumed run gets the same batches
+  bool start(size_t batch_size, size_t depth, uint32_t seed, size_t first_epoch, size_t first_batch = 0) {
+    pause();
+    if (batch_size == 0 || count() == 0 || m_num_outputs == 0)
+    {
+      cerr << "Error MkBatchProducer : no data, targets or batch size" << endl;
+      return false;
+    }
+
+    m_batch_size = min(batch_size, count());
+    m_batches_per_epoch = (count() + m_batch_size - 1) / m_batch_size;
+    // The in-flight batches must span at most two epochs (two permutations)
+    m_depth = max(size_t(1), min(depth, m_batches_per_epoch));
+    m_seed = seed;
+
+    m_slots.resize(m_depth);
+    for (size_t s = 0; s < m_depth; s++)
+    {
+      m_slots[s].index = s;
+      m_slots[s].labels.resize(m_batch_size);
+      m_slots[s].ready = false;
+    }
+    if (m_float) 
+      allocate(m_single);
+    else 
+      allocate(m_double);
+
+    unique_lock<mutex> lock(m_mutex);
+    m_perm_epoch[0] = m_perm_epoch[1] = uint64_t(-1);
+    m_next = m_consumed = uint64_t(first_epoch) * m_batches_per_epoch + min(first_batch, m_batches_per_epoch);
+    m_running = true;
+    lock.unlock();
+    m_work.notify_all();
+    return true;
+  }
+
+  /// Wait for the next batch and copy it to the KL buffers, return the batch size
+  /// The buffers keep the batch size capacity, so they are only allocated once
+  template<typename T> size_t fetch(
+    KL::VariableArray<KL::VariableArray<T> > &inputs,
+    KL::VariableArray<KL::VariableArray<T> > &targets,
+    KL::VariableArray<KL::UInt32>::IOParam labels)
+  {
+    Slot *slot = acquire();
+    if (!slot)
+      return 0;
+
+    if (inputs.size() < m_batch_size) inputs.resize(m_batch_size);
+    if (targets.size() < m_batch_size) targets.resize(m_batch_size);
+    if (labels.size() < m_batch_size) labels.resize(m_batch_size);
+    for (size_t i = 0; i < slot->size; i++)
+    {
+      inputs[i].resize(m_image_size);
+      targets[i].resize(m_num_outputs);
+      if (m_float)
+        copySample(m_single, *slot, i, &inputs[i][0], &targets[i][0]);
+      else
+        copySample(m_double, *slot, i, &inputs[i][0], &targets[i][0]);
+      labels[i] = slot->labels[i];
+    }
+    return release(slot);
+  }
+
+  /// Same as fetch, the batch is copied as [batch_size x features] tensors
+  template<typename T> size_t fetchBatch(
+    KL::VariableArray<T> &inputs,
+    KL::VariableArray<T> &targets,
+    KL::VariableArray<KL::UInt32>::IOParam labels)
+  {
+    Slot *slot = acquire();
+    if (!slot)
+      return 0;
+
+    if (inputs.size() < m_batch_size * m_image_size) inputs.resize(m_batch_size * m_image_size);
+    if (targets.size() < m_batch_size * m_num_outputs) targets.resize(m_batch_size * m_num_outputs);
+    if (labels.size() < m_batch_size) labels.resize(m_batch_size);
+    for (size_t i = 0; i < slot->size; i++)
+    {
+      if (m_float)
+        copySample(m_single, *slot, i, &inputs[i * m_image_size], &targets[i * m_num_outputs]);
+      else
+        copySample(m_double, *slot, i, &inputs[i * m_image_size], &targets[i * m_num_outputs]);
+      labels[i] = slot->labels[i];
+    }
+    return release(slot);
+  }
+
+private:
+  MkBatchProducerEngine(const MkBatchProducerEngine &);
+  MkBatchProducerEngine &operator=(const MkBatchProducerEngine &);
+
+  /// The inputs and targets of a slot are in MkBatchData at its index
+  struct Slot {
+    size_t index;
+    vector<uint32_t> labels;
+    size_t size;
+    bool ready;
+  };
+
+  MkBatchData<float> &data(float *) { return m_single; }
+  MkBatchData<double> &data(double *) { return m_double; }
+
+  /// Allocate the slots of the dataset precision
+  template<typename S> void allocate(MkBatchData<S> &data) {
+    data.inputs.resize(m_depth);
+    data.targets.resize(m_depth);
+    for (size_t s = 0; s < m_depth; s++)
+    {
+      data.inputs[s].resize(m_batch_size * m_image_size);
+      data.targets[s].resize(m_batch_size * m_num_outputs);
+    }
+  }
+
+  /// Copy the sample i of a slot, converted if T isn't the precision of the dataset
+  template<typename S, typename T> void copySample(
+    const MkBatchData<S> &data, 
+    const Slot &slot, 
+    size_t i, 
+    T *inputs, 
+    T *targets) 
+  {
+    const S *src_inputs = &data.inputs[slot.index][i * m_image_size];
+    const S *src_targets = &data.targets[slot.index][i * m_num_outputs];
+    copy(src_inputs, src_inputs + m_image_size, inputs);
+    copy(src_targets, src_targets + m_num_outputs, targets);
+  }
+
+  /// Wait for the next batch, the slot is not reused before it is released
+  Slot *acquire() {
+    unique_lock<mutex> lock(m_mutex);
+    if (!m_running)
+      return 0;
+    Slot &slot = m_slots[m_consumed % m_depth];
+    m_ready.wait(lock, [&]() { return slot.ready; });
+    return &slot;
+  }
+
+  /// Give the slot back to the workers, return the batch size
+  size_t release(Slot *slot) {
+    const size_t size = slot->size;
+    unique_lock<mutex> lock(m_mutex);
+    slot->ready = false;
+    m_consumed++;
+    lock.unlock();
+    m_work.notify_all();
+    return size;
+  }
+
+  /// Stop producing and wait for the workers to leave their batch
+  void pause() {
+    unique_lock<mutex> lock(m_mutex);
+    m_running = false;
+    m_idle.wait(lock, [this]() { return m_active == 0; });
+  }
+
+  /// Return the permutation of an epoch, called with the lock held
+  const vector<uint32_t> &permutation(uint64_t epoch) {
+    vector<uint32_t> &perm = m_perm[epoch & 1];
+    if (m_perm_epoch[epoch & 1] != epoch)
+    {
+      perm.resize(count());
+      for (size_t i = 0; i < perm.size(); i++)
+        perm[i] = uint32_t(i);
+      PhiloxShuffle(MkPhilox(m_seed, uint32_t(2 * epoch)), 0, perm.empty() ? 0 : &perm[0], perm.size());
+      m_perm_epoch[epoch & 1] = epoch;
+    }
+    return perm;
+  }
+
+  template<typename S> void fill(MkBatchData<S> &data, Slot &slot, uint64_t batch, const vector<uint32_t> &perm) {
+    const uint64_t epoch = batch / m_batches_per_epoch;
+    const size_t first = size_t(batch % m_batches_per_epoch) * m_batch_size;
+    const MkPhilox gen(m_seed, uint32_t(2 * epoch + 1));
+
+    slot.size = min(m_batch_size, count() - first);
+    for (size_t k = 0; k < slot.size; k++)
+    {
+      const uint32_t index = perm[first + k];
+      AugmentImage(&data.images[index * m_image_size], &data.inputs[slot.index][k * m_image_size],
+        m_width, m_height, m_channels, m_background, m_params, gen,
+        uint64_t(index) * BLOCKS_PER_SAMPLE);
+
+      S *target = &data.targets[slot.index][k * m_num_outputs];
+      for (size_t o = 0; o < m_num_outputs; o++)
+        target[o] = S(m_target_min);
+      target[m_labels[index]] = S(m_target_max);
+      slot.labels[k] = m_labels[index];
+    }
+  }
+
+  void workerLoop() {
+    while (true)
+    {
+      unique_lock<mutex> lock(m_mutex);
+      m_work.wait(lock, [this]() { return m_stop || (m_running && m_next < m_consumed + m_depth); });
+      if (m_stop)
+        return;
+
+      const uint64_t batch = m_next++;
+      const vector<uint32_t> &perm = permutation(batch / m_batches_per_epoch);
+      Slot &slot = m_slots[batch % m_depth];
+      m_active++;
+      lock.unlock();
+
+      if (m_float)
+        fill(m_single, slot, batch, perm);
+      else
+        fill(m_double, slot, batch, perm);
+
+      lock.lock();
+      slot.ready = true;
+      m_active--;
+      m_ready.notify_all();
+      if (m_active == 0)
+        m_idle.notify_all();
+    }
+  }
+
+  bool m_float;
+  MkBatchData<float> m_single;
+  MkBatchData<double> m_double;
+  vector<uint32_t> m_labels;
+  size_t m_width, m_height, m_channels, m_image_size;
+  double m_background;
+  size_t m_num_outputs;
+  double m_target_min, m_target_max;
+  MkAugmentParams m_params;
+
+  size_t m_batch_size, m_depth, m_batches_per_epoch;
+  uint32_t m_seed;
+  vector<Slot> m_slots;
+  vector<uint32_t> m_perm[2];
+  uint64_t m_perm_epoch[2];
+
+  vector<thread> m_workers;
+  mutex m_mutex;
+  condition_variable m_work;
+  condition_variable m_ready;
+  condition_variable m_idle;
+  bool m_stop;
+  bool m_running;
+  size_t m_active;
+
+  // Next batch to fill, next batch to fetch (counted from the first epoch)
+  uint64_t m_next;
+  uint64_t m_consumed;
+};
+
+inline MkBatchProducerEngine *GetProducer(KL::MkBatchProducer::INParam this_) {
+  return (MkBatchProducerEngine *) this_->handle;
+}
+
+FABRIC_EXT_EXPORT void MkBatchProducer_init(
+  KL::MkBatchProducer::IOParam this_,
+  KL::UInt32 num_workers)
+{
+  delete GetProducer(this_);
+  this_->handle = new MkBatchProducerEngine(num_workers > 0 ? num_workers : thread::hardware_concurrency());
+}
+
+FABRIC_EXT_EXPORT void MkBatchProducer_destroy(
+  KL::MkBatchProducer::IOParam this_)
+{
+  delete GetProducer(this_);
+  this_->handle = 0;
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkBatchProducer_setDataset(
+  KL::MkBatchProducer::IOParam this_,
+  KL::VariableArray<KL::Float64>::INParam images,
+  KL::VariableArray<KL::UInt32>::INParam labels,
+  KL::UInt32 width,
+  KL::UInt32 height,
+  KL::UInt32 channels,
+  KL::Float64 background)
+{
+  MkBatchProducerEngine *producer = GetProducer(this_);
+  return producer ? producer->setDataset(images, labels, width, height, channels, background) : false;
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkBatchProducer_setDataset_Float32(
+  KL::MkBatchProducer::IOParam this_,
+  KL::VariableArray<KL::Float32>::INParam images,
+  KL::VariableArray<KL::UInt32>::INParam labels,
+  KL::UInt32 width,
+  KL::UInt32 height,
+  KL::UInt32 channels,
+  KL::Float64 background)
+{
+  MkBatchProducerEngine *producer = GetProducer(this_);
+  return producer ? producer->setDataset(images, labels, width, height, channels, background) : false;
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkBatchProducer_setTargets(
+  KL::MkBatchProducer::IOParam this_,
+  KL::UInt32 num_outputs,
+  KL::Float64 target_min,
+  KL::Float64 target_max)
+{
+  MkBatchProducerEngine *producer = GetProducer(this_);
+  return producer ? producer->setTargets(num_outputs, target_min, target_max) : false;
+}
+
+FABRIC_EXT_EXPORT void MkBatchProducer_setParams(
+  KL::MkBatchProducer::IOParam this_,
+  KL::UInt32 max_shift,
+  KL::Boolean flip,
+  KL::Float64 max_rotation,
+  KL::Float64 max_scale,
+  KL::Float64 elastic)
+{
+  MkAugmentParams params;
+  params.max_shift = max_shift;
+  params.flip = flip;
+  params.max_rotation = max_rotation;
+  params.max_scale = max_scale;
+  params.elastic = elastic;
+  if (MkBatchProducerEngine *producer = GetProducer(this_))
+    producer->setParams(params);
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkBatchProducer_start(
+  KL::MkBatchProducer::IOParam this_,
+  KL::UInt32 batch_size,
+  KL::UInt32 depth,
+  KL::UInt32 seed,
+  KL::UInt32 first_epoch)
+{
+  MkBatchProducerEngine *producer = GetProducer(this_);
+  return producer ? producer->start(batch_size, depth, seed, first_epoch) : false;
+}
+
+FABRIC_EXT_EXPORT KL::Boolean MkBatchProducer_startAt(
+  KL::MkBatchProducer::IOParam this_,
+  KL::UInt32 batch_size,
+  KL::UInt32 depth,
+  KL::UInt32 seed,
+  KL::UInt32 first_epoch,
+  KL::UInt32 first_batch)
+{
+  MkBatchProducerEngine *producer = GetProducer(this_);
+  return producer ? producer->start(batch_size, depth, seed, first_epoch, first_batch) : false;
+}
+
+FABRIC_EXT_EXPORT KL::UInt32 MkBatchProducer_batchesPerEpoch(
+  KL::MkBatchProducer::INParam this_)
+{
+  MkBatchProducerEngine *producer = GetProducer(this_);
+  return producer ? KL::UInt32(producer->batchesPerEpoch()) : 0;
+}
+
+FABRIC_EXT_EXPORT KL::UInt32 MkBatchProducer_fetch(
+  KL::MkBatchProducer::IOParam this_,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::IOParam inputs,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::IOParam targets,
+  KL::VariableArray<KL::UInt32>::IOParam labels)
+{
+  MkBatchProducerEngine *producer = GetProducer(this_);
+  return producer ? KL::UInt32(producer->fetch(inputs, targets, labels)) : 0;
+}
+
+FABRIC_EXT_EXPORT KL::UInt32 MkBatchProducer_fetch_Float32(
+  KL::MkBatchProducer::IOParam this_,
+  KL::VariableArray<KL::VariableArray<KL::Float32> >::IOParam inputs,
+  KL::VariableArray<KL::VariableArray<KL::Float32> >::IOParam targets,
+  KL::VariableArray<KL::UInt32>::IOParam labels)
+{
+  MkBatchProducerEngine *producer = GetProducer(this_);
+  return producer ? KL::UInt32(producer->fetch(inputs, targets, labels)) : 0;
+}
+
+FABRIC_EXT_EXPORT KL::UInt32 MkBatchProducer_fetchBatch(
+  KL::MkBatchProducer::IOParam this_,
+  KL::VariableArray<KL::Float64>::IOParam inputs,
+  KL::VariableArray<KL::Float64>::IOParam targets,
+  KL::VariableArray<KL::UInt32>::IOParam labels)
+{
+  MkBatchProducerEngine *producer = GetProducer(this_);
+  return producer ? KL::UInt32(producer->fetchBatch(inputs, targets, labels)) : 0;
+}
+
+FABRIC_EXT_EXPORT KL::UInt32 MkBatchProducer_fetchBatch_Float32(
+  KL::MkBatchProducer::IOParam this_,
+  KL::VariableArray<KL::Float32>::IOParam inputs,
+  KL::VariableArray<KL::Float32>::IOParam targets,
+  KL::VariableArray<KL::UInt32>::IOParam labels)
+{
+  MkBatchProducerEngine *producer = GetProducer(this_);
+  return producer ? KL::UInt32(producer->fetchBatch(inputs, targets, labels)) : 0;
+}
@@ -19,6 +19,9 @@
 #include <algorithm>  
 #include <functional>
 #include <type_traits>
+#include <thread>
+#include <atomic>
+#include <sys/stat.h>
 using namespace std;
 
 #include <MkCIFAR.h>
@@ -28,220 +31,214 @@ using namespace Fabric::EDK;
 IMPLEMENT_FABRIC_EDK_ENTRIES( MkCIFAR )
 
 
-void ReadBatch(
-  string filename,
-  KL::VariableArray<KL::VariableArray<KL::Float64> > &images, 
-  KL::VariableArray<KL::UInt32> &labels) 
-{
-  ifstream file (filename, ios::binary);
-  if (file.is_open())
+// CIFAR-10 binary format : <1 x label><3072 x pixel> per record
+// The pixels are stored planar, 1024 red, then 1024 green, then 1024 blue
+const size_t CIFAR_ROWS = 32;
+const size_t CIFAR_COLS = 32;
+const size_t CIFAR_CHANNELS = 3;
+const size_t CIFAR_IMAGE_SIZE = CIFAR_ROWS * CIFAR_COLS * CIFAR_CHANNELS;
+const size_t CIFAR_RECORD_SIZE = 1 + CIFAR_IMAGE_SIZE;
+const size_t CIFAR_TRAINING_BATCHES = 5;
+
+/// Run task(i) for i in [0, count) on a pool of worker threads
+inline void ParallelFor(size_t count, const function<void(size_t)> &task) {
+  size_t num_threads = min(size_t(max(1u, thread::hardware_concurrency())), count);
+  if (num_threads <= 1)
   {
-    int number_of_images = 10000;
-    int n_rows = 32;
-    int n_cols = 32;
+    for (size_t i = 0; i < count; i++) task(i);
+    return;
+  }
 
-    double scale_max = 1.0;
-    double scale_min = -1.0;
+  atomic<size_t> next(0);
+  vector<thread> pool;
+  for (size_t t = 0; t < num_threads; t++)
+    pool.push_back(thread([&]() {
+      for (size_t i = next++; i < count; i = next++)
+        task(i);
+    }));
 
-    images.resize(number_of_images);
-    labels.resize(number_of_images);
+  for (size_t t = 0; t < pool.size(); t++)
+    pool[t].join();
+}
 
-    for(int i = 0; i < number_of_images; ++i)
-    {
-      unsigned char tplabel = 0;
-      file.read((char*) &tplabel, sizeof(tplabel));
-      labels[i] = KL::UInt32(tplabel);
-
-      KL::VariableArray<KL::VariableArray<KL::Float64> > channels;
-      channels.resize(3);
-      channels[0].resize(n_rows*n_cols);
-      channels[1].resize(n_rows*n_cols);
-      channels[2].resize(n_rows*n_cols);
-
-      images[i].resize(n_rows*n_cols*1);
-      for(int ch = 0; ch < 3; ++ch)
-      {
-        KL::UInt32 count = 0;
-        for(int r = 0; r < n_rows; ++r)
-        {
-          for(int c = 0; c < n_cols; ++c)
-          {
-            unsigned char temp = 0;
-            file.read((char*) &temp, sizeof(temp));
-            channels[ch][count] = KL::Float64(temp);
-            //images[i][count] = KL::Float64(res);
-            count++;
-            //cerr << (int)temp << " " << res << endl;
-          }
-        }
-      }
-
-      KL::UInt32 count = 0;
-      for(int r = 0; r < n_rows; ++r)
-      {
-        for(int c = 0; c < n_cols; ++c)
-        {
-          images[i][count] = (channels[0][count] + channels[1][count] + channels[2][count])/3.0;
-          //images[i][count] = ((int)images[i][count] / 255.0) * (scale_max - scale_min) + scale_min;
-          count ++;
-        }
-      }
-    }
+inline bool IsDirectory(const string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFDIR);
+}
+
+/// A directory is expanded to the five training batches it contains
+void ExpandBatchPath(const string &path, vector<string> &paths) {
+  if (!IsDirectory(path))
+  {
+    paths.push_back(path);
+    return;
   }
+
+  string dir = path;
+  if (dir.size() > 0 && dir[dir.size()-1] != '/' && dir[dir.size()-1] != '\\')
+    dir += "/";
+  for (size_t b = 1; b <= CIFAR_TRAINING_BATCHES; b++)
+    paths.push_back(dir + "data_batch_" + to_string(b) + ".bin");
 }
 
+/// Raw content of one batch file
+struct CIFARBatch {
+  string path;
+  vector<uint8_t> bytes;
+  size_t num_images;
+  bool valid;
+};
+
+/// Read a whole batch with a single bulk read
+void ReadBatch(CIFARBatch &batch) {
+  batch.num_images = 0;
+  batch.valid = false;
+
+  ifstream file(batch.path.c_str(), ios::in | ios::binary | ios::ate);
+  if (!file.is_open())
+    return;
+
+  streamoff size = file.tellg();
+  if (size <= 0 || size % CIFAR_RECORD_SIZE != 0)
+    return;
+
+  batch.bytes.resize(size_t(size));
+  file.seekg(0, ios::beg);
+  file.read((char*) &batch.bytes[0], size);
+  if (file.fail())
+    return;
+
+  batch.num_images = size_t(size) / CIFAR_RECORD_SIZE;
+  batch.valid = true;
+}
 
-FABRIC_EXT_EXPORT void MkCIFAR_parseBatch(
-  KL::MkCIFAR::INParam expr,
-  KL::String::INParam path,
-  KL::VariableArray<KL::VariableArray<KL::Float64> >::IOParam images, 
-  KL::VariableArray<KL::UInt32>::IOParam labels) 
+/// Read all the batches concurrently, offsets[b] is the index of the first image of batch b
+bool ReadBatches(
+  const vector<string> &paths,
+  vector<CIFARBatch> &batches,
+  vector<size_t> &offsets)
 {
-  ReadBatch(string(path.data()), images, labels);
-}
- 
-/*
-#define elif else if
-using namespace cv;
-using namespace std;
+  batches.resize(paths.size());
+  for (size_t b = 0; b < paths.size(); b++)
+    batches[b].path = paths[b];
 
-Mat concatenateMat(vector<Mat> &vec) {
+  ParallelFor(batches.size(), [&](size_t b) { ReadBatch(batches[b]); });
 
-  int height = vec[0].rows;
-  int width = vec[0].cols;
-  Mat res = Mat::zeros(height * width, vec.size(), CV_64FC1);
-  for(int i=0; i<vec.size(); i++)
+  offsets.assign(batches.size() + 1, 0);
+  for (size_t b = 0; b < batches.size(); b++)
   {
-    Mat img(height, width, CV_64FC1);
-    Mat gray(height, width, CV_8UC1);
-    cvtColor(vec[i], gray, CV_RGB2GRAY);
-    gray.convertTo(img, CV_64FC1);
-    // reshape(int cn, int rows=0), cn is num of channels.
-    Mat ptmat = img.reshape(0, height * width);
-    Rect roi = cv::Rect(i, 0, ptmat.cols, ptmat.rows);
-    Mat subView = res(roi);
-    ptmat.copyTo(subView);
+    if (!batches[b].valid)
+    {
+      cerr << "Error MkCIFAR : cannot read batch " << batches[b].path << endl;
+      return false;
+    }
+    offsets[b+1] = offsets[b] + batches[b].num_images;
   }
-  divide(res, 255.0, res);
-  return res;
+  return true;
 }
 
-Mat concatenateMatC(vector<Mat> &vec) {
+/// Normalize the batches concurrently, keep the planar RGB channels
+/// image(index) returns the destination of an image, allocated by the caller on this thread
+template<typename Image> void DecodeBatches(
+  const vector<CIFARBatch> &batches,
+  const vector<size_t> &offsets,
+  double scale_min,
+  double scale_max,
+  const Image &image,
+  KL::VariableArray<KL::UInt32> &labels) 
+{
+  double table[256];
+  for (int v = 0; v < 256; v++)
+    table[v] = (v / 255.0) * (scale_max - scale_min) + scale_min;
 
-  int height = vec[0].rows;
-  int width = vec[0].cols;
-  Mat res = Mat::zeros(height * width * 3, vec.size(), CV_64FC1);
-  for(int i=0; i<vec.size(); i++)
-  {
-    Mat img(height, width, CV_64FC3);
-    vec[i].convertTo(img, CV_64FC3);
-    vector<Mat> chs;
-    split(img, chs);
-    for(int j = 0; j < 3; j++)
+  ParallelFor(batches.size(), [&](size_t b) {
+    const uint8_t *record = &batches[b].bytes[0];
+    for (size_t i = 0; i < batches[b].num_images; i++, record += CIFAR_RECORD_SIZE)
     {
-      Mat ptmat = chs[j].reshape(0, height * width);
-      Rect roi = cv::Rect(i, j * ptmat.rows, ptmat.cols, ptmat.rows);
-      Mat subView = res(roi);
-      ptmat.copyTo(subView);
+      size_t index = offsets[b] + i;
+      labels[index] = KL::UInt32(record[0]);
+      auto dst = image(index);
+      for (size_t p = 0; p < CIFAR_IMAGE_SIZE; p++)
+        dst[p] = table[record[1 + p]];
     }
-  }
-  divide(res, 255.0, res);
-  return res;
+  });
+}
+
+FABRIC_EXT_EXPORT void MkCIFAR_parseBatch(
+  KL::MkCIFAR::INParam expr,
+  KL::String::INParam path,
+  KL::VariableArray<KL::VariableArray<KL::Float64> >::IOParam images, 
+  KL::VariableArray<KL::UInt32>::IOParam labels) 
+{
+  vector<string> paths;
+  ExpandBatchPath(string(path.data()), paths);
+
+  vector<CIFARBatch> batches;
+  vector<size_t> offsets;
+  if (!ReadBatches(paths, batches, offsets))
+    return;
+
+  images.resize(offsets.back());
+  labels.resize(offsets.back());
+  for (size_t i = 0; i < images.size(); i++)
+    images[i].resize(CIFAR_IMAGE_SIZE);
+  DecodeBatches(batches, offsets, -1.0, 1.0, 
+    [&](size_t index) { return &images[index][0]; }, labels);
 }
 
-void read_CIFAR10(
-  Mat &trainX, 
-  Mat &testX, 
-  Mat &trainY, 
-  Mat &testY)
+FABRIC_EXT_EXPORT void MkCIFAR_batchPaths(
+  KL::VariableArray<KL::String>::IOParam batch_paths,
+  KL::MkCIFAR::INParam expr,
+  KL::String::INParam path) 
 {
-  string filename;
-  filename = "cifar-10-batches-bin/data_batch_1.bin";
-  vector<Mat> batch1;
-  Mat label1 = Mat::zeros(1, 10000, CV_64FC1);    
-  read_batch(filename, batch1, label1);
-
-  filename = "cifar-10-batches-bin/data_batch_2.bin";
-  vector<Mat> batch2;
-  Mat label2 = Mat::zeros(1, 10000, CV_64FC1);    
-  read_batch(filename, batch2, label2);
-
-  filename = "cifar-10-batches-bin/data_batch_3.bin";
-  vector<Mat> batch3;
-  Mat label3 = Mat::zeros(1, 10000, CV_64FC1);    
-  read_batch(filename, batch3, label3);
-
-  filename = "cifar-10-batches-bin/data_batch_4.bin";
-  vector<Mat> batch4;
-  Mat label4 = Mat::zeros(1, 10000, CV_64FC1);    
-  read_batch(filename, batch4, label4);
-
-  filename = "cifar-10-batches-bin/data_batch_5.bin";
-  vector<Mat> batch5;
-  Mat label5 = Mat::zeros(1, 10000, CV_64FC1);    
-  read_batch(filename, batch5, label5);
-
-  filename = "cifar-10-batches-bin/test_batch.bin";
-  vector<Mat> batcht;
-  Mat labelt = Mat::zeros(1, 10000, CV_64FC1);    
-  read_batch(filename, batcht, labelt);
-
-  Mat mt1 = concatenateMat(batch1);
-  Mat mt2 = concatenateMat(batch2);
-  Mat mt3 = concatenateMat(batch3);
-  Mat mt4 = concatenateMat(batch4);
-  Mat mt5 = concatenateMat(batch5);
-  Mat mtt = concatenateMat(batcht);
-
-  Rect roi = cv::Rect(mt1.cols * 0, 0, mt1.cols, trainX.rows);
-  Mat subView = trainX(roi);
-  mt1.copyTo(subView);
-  roi = cv::Rect(label1.cols * 0, 0, label1.cols, 1);
-  subView = trainY(roi);
-  label1.copyTo(subView);
-
-  roi = cv::Rect(mt1.cols * 1, 0, mt1.cols, trainX.rows);
-  subView = trainX(roi);
-  mt2.copyTo(subView);
-  roi = cv::Rect(label1.cols * 1, 0, label1.cols, 1);
-  subView = trainY(roi);
-  label2.copyTo(subView);
-
-  roi = cv::Rect(mt1.cols * 2, 0, mt1.cols, trainX.rows);
-  subView = trainX(roi);
-  mt3.copyTo(subView);
-  roi = cv::Rect(label1.cols * 2, 0, label1.cols, 1);
-  subView = trainY(roi);
-  label3.copyTo(subView);
-
-  roi = cv::Rect(mt1.cols * 3, 0, mt1.cols, trainX.rows);
-  subView = trainX(roi);
-  mt4.copyTo(subView);
-  roi = cv::Rect(label1.cols * 3, 0, label1.cols, 1);
-  subView = trainY(roi);
-  label4.copyTo(subView);
-
-  roi = cv::Rect(mt1.cols * 4, 0, mt1.cols, trainX.rows);
-  subView = trainX(roi);
-  mt5.copyTo(subView);
-  roi = cv::Rect(label1.cols * 4, 0, label1.cols, 1);
-  subView = trainY(roi);
-  label5.copyTo(subView);
-
-  mtt.copyTo(testX);
-  labelt.copyTo(testY);
+  vector<string> paths;
+  ExpandBatchPath(string(path.data()), paths);
+  batch_paths.resize(paths.size());
+  for (size_t i = 0; i < paths.size(); i++)
+    batch_paths[i] = KL::String(paths[i].c_str());
 }
 
-int main() {
-  Mat trainX, testX;
-  Mat trainY, testY;
-  trainX = Mat::zeros(1024, 50000, CV_64FC1);  
-  testX = Mat::zeros(1024, 10000, CV_64FC1);  
-  trainY = Mat::zeros(1, 50000, CV_64FC1);  
-  testX = Mat::zeros(1, 10000, CV_64FC1);  
+/// Parse the batches in a single contiguous block, [num_images x 3072] at the network precision T
+template<typename T> void ParseBatches(
+  KL::VariableArray<KL::String>::INParam batch_paths,
+  double scale_min,
+  double scale_max,
+  KL::VariableArray<T> &images, 
+  KL::VariableArray<KL::UInt32> &labels) 
+{
+  vector<string> paths;
+  for (size_t i = 0; i < batch_paths.size(); i++)
+    ExpandBatchPath(string(batch_paths[i].data()), paths);
+
+  vector<CIFARBatch> batches;
+  vector<size_t> offsets;
+  if (!ReadBatches(paths, batches, offsets))
+    return;
+
+  images.resize(offsets.back() * CIFAR_IMAGE_SIZE);
+  labels.resize(offsets.back());
+  DecodeBatches(batches, offsets, scale_min, scale_max, 
+    [&](size_t index) { return &images[index * CIFAR_IMAGE_SIZE]; }, labels);
+}
 
-  read_CIFAR10(trainX, testX, trainY, testY);
+FABRIC_EXT_EXPORT void MkCIFAR_parseBatches_Float32(
+  KL::MkCIFAR::INParam expr,
+  KL::VariableArray<KL::String>::INParam batch_paths,
+  KL::Float64 scale_min,
+  KL::Float64 scale_max,
+  KL::VariableArray<KL::Float32>::IOParam images, 
+  KL::VariableArray<KL::UInt32>::IOParam labels) 
+{
+  ParseBatches(batch_paths, scale_min, scale_max, images, labels);
+}
 
-  return 0;
+FABRIC_EXT_EXPORT void MkCIFAR_parseBatches_Float64(
+  KL::MkCIFAR::INParam expr,
+  KL::VariableArray<KL::String>::INParam batch_paths,
+  KL::Float64 scale_min,
+  KL::Float64 scale_max,
+  KL::VariableArray<KL::Float64>::IOParam images, 
+  KL::VariableArray<KL::UInt32>::IOParam labels) 
+{
+  ParseBatches(batch_paths, scale_min, scale_max, images, labels);
 }
-*/
\ No newline at end of file
@@ -0,0 +1,146 @@
+/**************************************************************************************************/
+/*                                                                                                */
+/*  Informations :                                                                                */
+/*      This code is part of the project MLKL                                                     */
+/*                                                                                                */
+/*  Contacts :                                                                                    */
+/*      couet.julien@gmail.com                                                                    */
+/*                                                                                                */
+/**************************************************************************************************/
+
+#ifndef __MK_PHILOX_H__
+#define __MK_PHILOX_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <type_traits>
+
+// Counter-based random generator, Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+// A block of 4 random words is a pure function of a (key, counter) pair : there is no shared state,
+// streams with different keys are independent and any block can be drawn in any order by any thread.
+struct MkPhilox {
+  uint32_t key[2];
+
+  MkPhilox(uint32_t seed, uint32_t stream) {
+    key[0] = seed;
+    key[1] = stream;
+  }
+
+  inline void block(uint64_t counter, uint32_t out[4]) const {
+    uint32_t c0 = uint32_t(counter), c1 = uint32_t(counter >> 32), c2 = 0, c3 = 0;
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int r = 0; r < 10; r++)
+    {
+      uint64_t p0 = uint64_t(0xD2511F53) * c0;
+      uint64_t p1 = uint64_t(0xCD9E8D57) * c2;
+      uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+      uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+      c1 = uint32_t(p1);
+      c3 = uint32_t(p0);
+      c0 = n0;
+      c2 = n2;
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+  }
+};
+
+/// Map random words to [0, 1)
+inline float ToUnit(uint32_t x, float) {
+  return float(x >> 8) * (1.0f / 16777216.0f);
+}
+
+inline double ToUnit(uint32_t x, double) {
+  return double(x) * (1.0 / 4294967296.0);
+}
+
+/// Map a random word to [min, max] by a multiply-shift, without a division
+/// The bias is at most range / 2^32, negligible for the small ranges drawn here
+template<typename T> inline 
+typename std::enable_if<std::is_integral<T>::value, T>::type FromWord(uint32_t x, T min, T max) {
+  uint64_t range = uint64_t(int64_t(max) - int64_t(min)) + 1;
+  if (range > 0xFFFFFFFFULL) return T(int64_t(min) + x);
+  return T(int64_t(min) + int64_t((uint64_t(x) * range) >> 32));
+}
+
+template<typename T> inline 
+typename std::enable_if<std::is_floating_point<T>::value, T>::type FromWord(uint32_t x, T min, T max) {
+  return min + ToUnit(x, T()) * (max - min);
+}
+
+/// Fill val[0, size) from the blocks [counter, counter + ceil(size/4)), return the next counter
+template<typename T> inline uint64_t PhiloxFill(
+  const MkPhilox &gen, 
+  uint64_t counter, 
+  T *val, 
+  size_t size, 
+  T min, 
+  T max) 
+{
+  size_t blocks = size / 4;
+  for (size_t b = 0; b < blocks; b++)
+  {
+    uint32_t words[4];
+    gen.block(counter + b, words);
+    val[4*b + 0] = FromWord(words[0], min, max);
+    val[4*b + 1] = FromWord(words[1], min, max);
+    val[4*b + 2] = FromWord(words[2], min, max);
+    val[4*b + 3] = FromWord(words[3], min, max);
+  }
+
+  if (4 * blocks < size)
+  {
+    uint32_t words[4];
+    gen.block(counter + blocks, words);
+    for (size_t i = 4 * blocks; i < size; i++)
+      val[i] = FromWord(words[i - 4 * blocks], min, max);
+    blocks++;
+  }
+  return counter + blocks;
+}
+
+/// Fill mask[0, size) with 1 with probability p, 0 otherwise
+template<typename T> inline uint64_t PhiloxBernoulli(
+  const MkPhilox &gen, 
+  uint64_t counter, 
+  T *mask, 
+  size_t size, 
+  double p) 
+{
+  // Compare the raw words to a threshold, no conversion to floating point
+  const uint64_t threshold = uint64_t(std::max(0.0, std::min(1.0, p)) * 4294967296.0);
+  size_t blocks = (size + 3) / 4;
+  for (size_t b = 0; b < blocks; b++)
+  {
+    uint32_t words[4];
+    gen.block(counter + b, words);
+    for (size_t w = 0; w < 4 && 4*b + w < size; w++)
+      mask[4*b + w] = T(uint64_t(words[w]) < threshold);
+  }
+  return counter + blocks;
+}
+
+/// Fisher-Yates shuffle of val[0, size), drawn from the blocks following counter
+template<typename T> inline uint64_t PhiloxShuffle(
+  const MkPhilox &gen, 
+  uint64_t counter, 
+  T *val, 
+  size_t size) 
+{
+  uint32_t words[4];
+  size_t w = 4;
+  for (size_t i = size; i > 1; i--)
+  {
+    if (w == 4)
+    {
+      gen.block(counter++, words);
+      w = 0;
+    }
+    std::swap(val[i - 1], val[FromWord(words[w++], size_t(0), i - 1)]);
+  }
+  return counter;
+}
+
+#endif // __MK_PHILOX_H__
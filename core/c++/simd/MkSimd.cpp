@@ -0,0 +1,432 @@
+/**************************************************************************************************/
+/*                                                                                                */
+/*  Informations :                                                                                */
+/*      This code is part of the project MLKL                                                     */
+/*                                                                                                */
+/*  Contacts :                                                                                    */
+/*      couet.julien@gmail.com                                                                    */
+/*                                                                                                */
+/**************************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+using namespace std;
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include <MkSimd.h>
+#include <MkSimdTable.h>
+#include <FabricEDK.h>
+using namespace Fabric::EDK;
+
+IMPLEMENT_FABRIC_EDK_ENTRIES( MkSimd )
+
+
+/**************************************************************************************************/
+/*                                                Dispatch                                        */
+inline void Cpuid(int regs[4], int leaf, int subleaf) {
+#if defined(_MSC_VER)
+  __cpuidex(regs, leaf, subleaf);
+#else
+  unsigned int a, b, c, d;
+  __cpuid_count(leaf, subleaf, a, b, c, d);
+  regs[0] = int(a); regs[1] = int(b); regs[2] = int(c); regs[3] = int(d);
+#endif
+}
+
+/// Register states saved by the OS (XCR0)
+inline uint64_t Xgetbv() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  unsigned int a, d;
+  __asm__ volatile("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+  return (uint64_t(d) << 32) | a;
+#endif
+}
+
+/// Best instruction set supported by the CPU and enabled by the OS
+int MkSimdCpuLevel() {
+  int regs[4];
+  Cpuid(regs, 0, 0);
+  int max_leaf = regs[0];
+
+  Cpuid(regs, 1, 0);
+  bool sse2 = (regs[3] & (1 << 26)) != 0;
+  bool osxsave = (regs[2] & (1 << 27)) != 0;
+  bool avx = (regs[2] & (1 << 28)) != 0;
+  bool fma = (regs[2] & (1 << 12)) != 0;
+  if (!sse2)
+    return MK_SIMD_SCALAR;
+  if (!osxsave || !avx || !fma || max_leaf < 7)
+    return MK_SIMD_SSE2;
+
+  uint64_t xcr0 = Xgetbv();
+  if ((xcr0 & 0x6) != 0x6)
+    return MK_SIMD_SSE2;
+
+  Cpuid(regs, 7, 0);
+  bool avx2 = (regs[1] & (1 << 5)) != 0;
+  bool avx512f = (regs[1] & (1 << 16)) != 0;
+  if (!avx2)
+    return MK_SIMD_SSE2;
+  // opmask, upper ZMM and high ZMM states
+  if (avx512f && (xcr0 & 0xE6) == 0xE6)
+    return MK_SIMD_AVX512;
+  return MK_SIMD_AVX2;
+}
+
+/// Level asked by the environment, -1 for MLKL_SIMD=off
+int MkSimdEnvLevel() {
+  const char *env = getenv("MLKL_SIMD");
+  if (!env || !*env) return MK_SIMD_AVX512;
+  if (!strcmp(env, "off")) return -1;
+  if (!strcmp(env, "scalar")) return MK_SIMD_SCALAR;
+  if (!strcmp(env, "sse2")) return MK_SIMD_SSE2;
+  if (!strcmp(env, "avx2")) return MK_SIMD_AVX2;
+  if (!strcmp(env, "avx512")) return MK_SIMD_AVX512;
+  cerr << "Error MkSimd : unknown MLKL_SIMD value " << env << endl;
+  return MK_SIMD_AVX512;
+}
+
+struct MkSimdDispatch {
+  MkSimdTable table;
+  bool enabled;
+
+  MkSimdDispatch() {
+    int env = MkSimdEnvLevel();
+    enabled = env >= 0;
+    int level = MkSimdCpuLevel();
+    if (env >= 0 && env < level)
+      level = env;
+
+    if (level >= MK_SIMD_AVX512) MkSimdTableAVX512(table);
+    else if (level >= MK_SIMD_AVX2) MkSimdTableAVX2(table);
+    else if (level >= MK_SIMD_SSE2) MkSimdTableSSE2(table);
+    else MkSimdTableScalar(table);
+  }
+};
+
+/// Built at the first call, thread-safe in C++11
+const MkSimdDispatch &GetDispatch() {
+  static MkSimdDispatch dispatch;
+  return dispatch;
+}
+
+const MkSimdTable &MkSimdGetTable() {
+  return GetDispatch().table;
+}
+
+template<typename T> inline const MkSimdKernels<T> &GetKernels();
+template<> inline const MkSimdKernels<float> &GetKernels<float>() { return MkSimdGetTable().f32; }
+template<> inline const MkSimdKernels<double> &GetKernels<double>() { return MkSimdGetTable().f64; }
+
+/// Check that [offset, offset + n) is within an array of the given size
+inline bool InRange(const char *function, size_t offset, size_t n, size_t size) {
+  if (offset + n <= size)
+    return true;
+  cerr << "Error MkSimd : " << function << " range [" << offset << ", " << offset + n
+    << ") out of " << size << endl;
+  return false;
+}
+/*                                                Dispatch                                        */
+/**************************************************************************************************/
+
+                                          /***********************/
+
+/**************************************************************************************************/
+/*                                                Kernels                                         */
+template<typename T> T Dot(
+  KL::UInt32 n,
+  const KL::VariableArray<T> &a,
+  KL::UInt32 a_offset,
+  const KL::VariableArray<T> &b,
+  KL::UInt32 b_offset)
+{
+  if (n == 0 || !InRange("dot", a_offset, n, a.size()) || !InRange("dot", b_offset, n, b.size()))
+    return T(0);
+  return GetKernels<T>().dot(n, &a[a_offset], &b[b_offset]);
+}
+
+template<typename T> void Axpy(
+  KL::UInt32 n,
+  T alpha,
+  const KL::VariableArray<T> &x,
+  KL::UInt32 x_offset,
+  KL::VariableArray<T> &y,
+  KL::UInt32 y_offset)
+{
+  if (n == 0 || !InRange("axpy", x_offset, n, x.size()) || !InRange("axpy", y_offset, n, y.size()))
+    return;
+  GetKernels<T>().axpy(n, alpha, &x[x_offset], &y[y_offset]);
+}
+
+template<typename T> void Gemv(
+  bool trans,
+  KL::UInt32 m,
+  KL::UInt32 n,
+  const KL::VariableArray<T> &a,
+  const KL::VariableArray<T> &x,
+  T beta,
+  KL::VariableArray<T> &y,
+  KL::UInt32 begin,
+  KL::UInt32 end)
+{
+  if (begin >= end || !InRange("gemv", 0, size_t(m) * n, a.size()) ||
+    !InRange("gemv", 0, trans ? m : n, x.size()) || !InRange("gemv", begin, end - begin, y.size()))
+    return;
+  GetKernels<T>().gemv(trans, m, n, &a[0], &x[0], beta, &y[0], begin, end);
+}
+
+template<typename T> void Gemm(
+  bool trans_a,
+  bool trans_b,
+  bool accumulate,
+  KL::UInt32 m,
+  KL::UInt32 n,
+  KL::UInt32 k,
+  const KL::VariableArray<T> &a,
+  const KL::VariableArray<T> &b,
+  KL::VariableArray<T> &c,
+  KL::UInt32 i0,
+  KL::UInt32 i1,
+  KL::UInt32 j0,
+  KL::UInt32 j1)
+{
+  if (i0 >= i1 || j0 >= j1 || i1 > m || j1 > n)
+    return;
+  if (!InRange("gemm", 0, size_t(m) * k, a.size()) || !InRange("gemm", 0, size_t(k) * n, b.size()) ||
+    !InRange("gemm", 0, size_t(m) * n, c.size()))
+    return;
+  if (k == 0)
+  {
+    if (!accumulate)
+      for (size_t i = i0; i < i1; i++)
+        for (size_t j = j0; j < j1; j++)
+          c[i*n + j] = T(0);
+    return;
+  }
+  GetKernels<T>().gemm(trans_a, trans_b, accumulate, m, n, k, &a[0], &b[0], &c[0], i0, i1, j0, j1);
+}
+
+template<typename T> void Activation(
+  KL::UInt32 neuron,
+  KL::UInt32 offset,
+  KL::UInt32 n,
+  KL::VariableArray<T> &y)
+{
+  if (n == 0 || !InRange("activation", offset, n, y.size()))
+    return;
+  GetKernels<T>().activation(neuron, n, &y[offset], &y[offset]);
+}
+
+template<typename T> void Derivative(
+  KL::UInt32 neuron,
+  KL::UInt32 offset,
+  KL::UInt32 n,
+  const KL::VariableArray<T> &y,
+  KL::VariableArray<T> &delta)
+{
+  if (n == 0 || !InRange("derivative", offset, n, y.size()) || !InRange("derivative", offset, n, delta.size()))
+    return;
+  GetKernels<T>().derivative(neuron, n, &y[offset], &delta[offset], &delta[offset]);
+}
+
+template<typename T> void Update(
+  KL::UInt32 offset,
+  KL::UInt32 n,
+  double alpha,
+  double mu,
+  const KL::VariableArray<T> &dw,
+  const KL::VariableArray<T> *h,
+  KL::VariableArray<T> &w)
+{
+  if (n == 0 || !InRange("update", offset, n, dw.size()) || !InRange("update", offset, n, w.size()) ||
+    (h && !InRange("update", offset, n, h->size())))
+    return;
+  GetKernels<T>().update(n, alpha, mu, &dw[offset], h ? &(*h)[offset] : 0, &w[offset]);
+}
+
+template<typename T> void UpdateMaster(
+  KL::UInt32 offset,
+  KL::UInt32 n,
+  double alpha,
+  double mu,
+  const KL::VariableArray<T> &dw,
+  const KL::VariableArray<T> *h,
+  KL::VariableArray<KL::Float64> &master,
+  KL::VariableArray<T> &w)
+{
+  if (n == 0 || !InRange("updateMaster", offset, n, dw.size()) || !InRange("updateMaster", offset, n, w.size()) ||
+    !InRange("updateMaster", offset, n, master.size()) || (h && !InRange("updateMaster", offset, n, h->size())))
+    return;
+  GetKernels<T>().updateMaster(n, alpha, mu, &dw[offset], h ? &(*h)[offset] : 0, &master[offset], &w[offset]);
+}
+
+KL::SInt32 DotInt8(
+  KL::UInt32 n,
+  const KL::VariableArray<KL::SInt8> &a,
+  KL::UInt32 a_offset,
+  const KL::VariableArray<KL::SInt8> &b,
+  KL::UInt32 b_offset)
+{
+  if (n == 0 || !InRange("dotInt8", a_offset, n, a.size()) || !InRange("dotInt8", b_offset, n, b.size()))
+    return 0;
+  return MkSimdGetTable().dotInt8(n, (const int8_t *)&a[a_offset], (const int8_t *)&b[b_offset]);
+}
+/*                                                Kernels                                         */
+/**************************************************************************************************/
+
+                                          /***********************/
+
+/**************************************************************************************************/
+/*                                               KL bindings                                      */
+FABRIC_EXT_EXPORT KL::Boolean MkSimd_enabled() {
+  return GetDispatch().enabled;
+}
+
+FABRIC_EXT_EXPORT KL::UInt32 MkSimd_level() {
+  return KL::UInt32(MkSimdGetTable().level);
+}
+
+// Float32 and Float64 entries of every kernel, MkCNNReal picks one of them
+#define MK_SIMD_EXPORT(KLType, Suffix)                                                              \
+FABRIC_EXT_EXPORT KLType MkSimd_dot_##Suffix(                                                       \
+  KL::UInt32 n,                                                                                     \
+  KL::VariableArray<KLType>::INParam a,                                                             \
+  KL::UInt32 a_offset,                                                                              \
+  KL::VariableArray<KLType>::INParam b,                                                             \
+  KL::UInt32 b_offset)                                                                              \
+{                                                                                                   \
+  return Dot<KLType>(n, a, a_offset, b, b_offset);                                                  \
+}                                                                                                   \
+                                                                                                    \
+FABRIC_EXT_EXPORT void MkSimd_axpy_##Suffix(                                                        \
+  KL::UInt32 n,                                                                                     \
+  KLType alpha,                                                                                     \
+  KL::VariableArray<KLType>::INParam x,                                                             \
+  KL::UInt32 x_offset,                                                                              \
+  KL::VariableArray<KLType>::IOParam y,                                                             \
+  KL::UInt32 y_offset)                                                                              \
+{                                                                                                   \
+  Axpy<KLType>(n, alpha, x, x_offset, y, y_offset);                                                 \
+}                                                                                                   \
+                                                                                                    \
+FABRIC_EXT_EXPORT void MkSimd_gemv_##Suffix(                                                        \
+  KL::Boolean trans,                                                                                \
+  KL::UInt32 m,                                                                                     \
+  KL::UInt32 n,                                                                                     \
+  KL::VariableArray<KLType>::INParam a,                                                             \
+  KL::VariableArray<KLType>::INParam x,                                                             \
+  KLType beta,                                                                                      \
+  KL::VariableArray<KLType>::IOParam y,                                                             \
+  KL::UInt32 begin,                                                                                 \
+  KL::UInt32 end)                                                                                   \
+{                                                                                                   \
+  Gemv<KLType>(trans, m, n, a, x, beta, y, begin, end);                                             \
+}                                                                                                   \
+                                                                                                    \
+FABRIC_EXT_EXPORT void MkSimd_gemm_##Suffix(                                                        \
+  KL::Boolean trans_a,                                                                              \
+  KL::Boolean trans_b,                                                                              \
+  KL::Boolean accumulate,                                                                           \
+  KL::UInt32 m,                                                                                     \
+  KL::UInt32 n,                                                                                     \
+  KL::UInt32 k,                                                                                     \
+  KL::VariableArray<KLType>::INParam a,                                                             \
+  KL::VariableArray<KLType>::INParam b,                                                             \
+  KL::VariableArray<KLType>::IOParam c,                                                             \
+  KL::UInt32 i0,                                                                                    \
+  KL::UInt32 i1,                                                                                    \
+  KL::UInt32 j0,                                                                                    \
+  KL::UInt32 j1)                                                                                    \
+{                                                                                                   \
+  Gemm<KLType>(trans_a, trans_b, accumulate, m, n, k, a, b, c, i0, i1, j0, j1);                     \
+}                                                                                                   \
+                                                                                                    \
+FABRIC_EXT_EXPORT void MkSimd_activation_##Suffix(                                                  \
+  KL::UInt32 neuron,                                                                                \
+  KL::UInt32 offset,                                                                                \
+  KL::UInt32 n,                                                                                     \
+  KL::VariableArray<KLType>::IOParam y)                                                             \
+{                                                                                                   \
+  Activation<KLType>(neuron, offset, n, y);                                                         \
+}                                                                                                   \
+                                                                                                    \
+FABRIC_EXT_EXPORT void MkSimd_derivative_##Suffix(                                                  \
+  KL::UInt32 neuron,                                                                                \
+  KL::UInt32 offset,                                                                                \
+  KL::UInt32 n,                                                                                     \
+  KL::VariableArray<KLType>::INParam y,                                                             \
+  KL::VariableArray<KLType>::IOParam delta)                                                         \
+{                                                                                                   \
+  Derivative<KLType>(neuron, offset, n, y, delta);                                                  \
+}                                                                                                   \
+                                                                                                    \
+FABRIC_EXT_EXPORT void MkSimd_update_##Suffix(                                                      \
+  KL::UInt32 offset,                                                                                \
+  KL::UInt32 n,                                                                                     \
+  KL::Float64 alpha,                                                                                \
+  KL::Float64 mu,                                                                                   \
+  KL::VariableArray<KLType>::INParam dw,                                                            \
+  KL::VariableArray<KLType>::IOParam w)                                                             \
+{                                                                                                   \
+  Update<KLType>(offset, n, alpha, mu, dw, 0, w);                                                   \
+}                                                                                                   \
+                                                                                                    \
+FABRIC_EXT_EXPORT void MkSimd_updateHessian_##Suffix(                                               \
+  KL::UInt32 offset,                                                                                \
+  KL::UInt32 n,                                                                                     \
+  KL::Float64 alpha,                                                                                \
+  KL::Float64 mu,                                                                                   \
+  KL::VariableArray<KLType>::INParam dw,                                                            \
+  KL::VariableArray<KLType>::INParam h,                                                             \
+  KL::VariableArray<KLType>::IOParam w)                                                             \
+{                                                                                                   \
+  Update<KLType>(offset, n, alpha, mu, dw, &h, w);                                                  \
+}                                                                                                   \
+                                                                                                    \
+FABRIC_EXT_EXPORT void MkSimd_updateMaster_##Suffix(                                                \
+  KL::UInt32 offset,                                                                                \
+  KL::UInt32 n,                                                                                     \
+  KL::Float64 alpha,                                                                                \
+  KL::Float64 mu,                                                                                   \
+  KL::VariableArray<KLType>::INParam dw,                                                            \
+  KL::VariableArray<KL::Float64>::IOParam master,                                                   \
+  KL::VariableArray<KLType>::IOParam w)                                                             \
+{                                                                                                   \
+  UpdateMaster<KLType>(offset, n, alpha, mu, dw, 0, master, w);                                     \
+}                                                                                                   \
+                                                                                                    \
+FABRIC_EXT_EXPORT void MkSimd_updateMasterHessian_##Suffix(                                         \
+  KL::UInt32 offset,                                                                                \
+  KL::UInt32 n,                                                                                     \
+  KL::Float64 alpha,                                                                                \
+  KL::Float64 mu,                                                                                   \
+  KL::VariableArray<KLType>::INParam dw,                                                            \
+  KL::VariableArray<KLType>::INParam h,                                                             \
+  KL::VariableArray<KL::Float64>::IOParam master,                                                   \
+  KL::VariableArray<KLType>::IOParam w)                                                             \
+{                                                                                                   \
+  UpdateMaster<KLType>(offset, n, alpha, mu, dw, &h, master, w);                                    \
+}
+
+MK_SIMD_EXPORT(KL::Float32, Float32)
+MK_SIMD_EXPORT(KL::Float64, Float64)
+
+FABRIC_EXT_EXPORT KL::SInt32 MkSimd_dot_SInt8(
+  KL::UInt32 n,
+  KL::VariableArray<KL::SInt8>::INParam a,
+  KL::UInt32 a_offset,
+  KL::VariableArray<KL::SInt8>::INParam b,
+  KL::UInt32 b_offset)
+{
+  return DotInt8(n, a, a_offset, b, b_offset);
+}
+/*                                               KL bindings                                      */
+/**************************************************************************************************/
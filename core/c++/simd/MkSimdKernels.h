@@ -0,0 +1,449 @@
+/**************************************************************************************************/
+/*                                                                                                */
+/*  Informations :                                                                                */
+/*      This code is part of the project MLKL                                                     */
+/*                                                                                                */
+/*  Contacts :                                                                                    */
+/*      couet.julien@gmail.com                                                                    */
+/*                                                                                                */
+/**************************************************************************************************/
+
+// Kernels written once for a generic vector type V, included by each MkSimd_<isa>.cpp.
+// V provides : Scalar, Reg, W (lanes), load, store, set1, zero, add, sub, mul, div, fmadd,
+// min, max, hsum, exp and positive (d where y > 0, 0 elsewhere).
+//
+// No include guard and no include : everything lands in the anonymous namespace of the
+// including translation unit, so the instances compiled with AVX flags can't be merged by
+// the linker with the ones of another instruction set. For the same reason, no std template
+// is used here.
+
+namespace {
+
+/**************************************************************************************************/
+/*                                                Scalar                                          */
+template<typename T> struct MkSimdScalar {
+  typedef T Scalar;
+  typedef T Reg;
+  enum { W = 1 };
+
+  static inline Reg load(const T *p) { return *p; }
+  static inline void store(T *p, Reg x) { *p = x; }
+  static inline Reg set1(T x) { return x; }
+  static inline Reg zero() { return T(0); }
+  static inline Reg add(Reg a, Reg b) { return a + b; }
+  static inline Reg sub(Reg a, Reg b) { return a - b; }
+  static inline Reg mul(Reg a, Reg b) { return a * b; }
+  static inline Reg div(Reg a, Reg b) { return a / b; }
+  static inline Reg fmadd(Reg a, Reg b, Reg c) { return a * b + c; }
+  static inline Reg min(Reg a, Reg b) { return a < b ? a : b; }
+  static inline Reg max(Reg a, Reg b) { return a > b ? a : b; }
+  static inline T hsum(Reg x) { return x; }
+  static inline Reg exp(Reg x) { return T(::exp(double(x))); }
+  static inline Reg positive(Reg y, Reg d) { return y > T(0) ? d : T(0); }
+};
+
+/// exp for the vector types, range reduction x = n*ln2 + r then a Taylor polynomial on
+/// |r| < ln2/2, degree 7 in Float32 and 12 in Float64 (a few ulps)
+template<class V> inline typename V::Reg MkSimdExp(typename V::Reg x) {
+  typedef typename V::Scalar T;
+  typedef typename V::Reg Reg;
+  const bool single = sizeof(T) == 4;
+  const int degree = single ? 7 : 12;
+
+  x = V::min(V::max(x, V::set1(T(single ? -87.0 : -708.0))), V::set1(T(single ? 88.0 : 709.0)));
+  Reg n = V::round(V::mul(x, V::set1(T(1.4426950408889634))));
+  Reg r = V::fmadd(n, V::set1(T(single ? -0.693359375 : -6.93145751953125E-1)), x);
+  r = V::fmadd(n, V::set1(T(single ? 2.12194440e-4 : -1.42860682030941723212E-6)), r);
+
+  double factorial = 1.0;
+  for (int k = 2; k <= degree; k++)
+    factorial *= k;
+  Reg p = V::set1(T(1.0 / factorial));
+  for (int k = degree; k > 0; k--)
+  {
+    factorial /= k;
+    p = V::fmadd(p, r, V::set1(T(1.0 / factorial)));
+  }
+  return V::mul(p, V::pow2n(n));
+}
+/*                                                Scalar                                          */
+/**************************************************************************************************/
+
+                                          /***********************/
+
+/**************************************************************************************************/
+/*                                                BLAS-1/2                                        */
+template<class V> typename V::Scalar Dot(size_t n, const typename V::Scalar *a, const typename V::Scalar *b) {
+  typedef typename V::Scalar T;
+  typedef MkSimdScalar<T> S;
+  typename V::Reg acc0 = V::zero(), acc1 = V::zero(), acc2 = V::zero(), acc3 = V::zero();
+
+  size_t i = 0;
+  for (; i + 4*V::W <= n; i += 4*V::W)
+  {
+    acc0 = V::fmadd(V::load(a + i), V::load(b + i), acc0);
+    acc1 = V::fmadd(V::load(a + i + V::W), V::load(b + i + V::W), acc1);
+    acc2 = V::fmadd(V::load(a + i + 2*V::W), V::load(b + i + 2*V::W), acc2);
+    acc3 = V::fmadd(V::load(a + i + 3*V::W), V::load(b + i + 3*V::W), acc3);
+  }
+  for (; i + V::W <= n; i += V::W)
+    acc0 = V::fmadd(V::load(a + i), V::load(b + i), acc0);
+
+  T sum = V::hsum(V::add(V::add(acc0, acc1), V::add(acc2, acc3)));
+  for (; i < n; i++)
+    sum = S::fmadd(a[i], b[i], sum);
+  return sum;
+}
+
+template<class V> void Axpy(size_t n, typename V::Scalar alpha, const typename V::Scalar *x, typename V::Scalar *y) {
+  typedef MkSimdScalar<typename V::Scalar> S;
+  typename V::Reg va = V::set1(alpha);
+
+  size_t i = 0;
+  for (; i + V::W <= n; i += V::W)
+    V::store(y + i, V::fmadd(va, V::load(x + i), V::load(y + i)));
+  for (; i < n; i++)
+    y[i] = S::fmadd(alpha, x[i], y[i]);
+}
+
+template<class V> void Gemv(
+  bool trans,
+  size_t m,
+  size_t n,
+  const typename V::Scalar *a,
+  const typename V::Scalar *x,
+  typename V::Scalar beta,
+  typename V::Scalar *y,
+  size_t begin,
+  size_t end)
+{
+  typedef typename V::Scalar T;
+  if (!trans)
+  {
+    // One dot product per row
+    for (size_t i = begin; i < end; i++)
+      y[i] = Dot<V>(n, a + i*n, x) + (beta == T(0) ? T(0) : beta * y[i]);
+    return;
+  }
+
+  // y = A^T x, accumulated row by row so the loads stay contiguous
+  for (size_t j = begin; j < end; j++)
+    y[j] = (beta == T(0)) ? T(0) : beta * y[j];
+  for (size_t i = 0; i < m; i++)
+    if (x[i] != T(0))
+      Axpy<V>(end - begin, x[i], a + i*n + begin, y + begin);
+}
+/*                                                BLAS-1/2                                        */
+/**************************************************************************************************/
+
+                                          /***********************/
+
+/**************************************************************************************************/
+/*                                                  GEMM                                          */
+/// C rows += op(A)[i] * B, B not transposed : the columns of C are vectorized,
+/// 4 registers of C stay in flight while the k dimension is scanned
+template<class V> void GemmNN(
+  bool trans_a,
+  size_t m,
+  size_t n,
+  size_t k,
+  const typename V::Scalar *a,
+  const typename V::Scalar *b,
+  typename V::Scalar *c,
+  size_t i0,
+  size_t i1,
+  size_t j0,
+  size_t j1)
+{
+  typedef typename V::Scalar T;
+  typedef typename V::Reg Reg;
+  typedef MkSimdScalar<T> S;
+
+  size_t j = j0;
+  // The B panel [k x 4W] is reused from the cache by every row
+  for (; j + 4*V::W <= j1; j += 4*V::W)
+  {
+    for (size_t i = i0; i < i1; i++)
+    {
+      T *ci = c + i*n + j;
+      Reg c0 = V::load(ci), c1 = V::load(ci + V::W), c2 = V::load(ci + 2*V::W), c3 = V::load(ci + 3*V::W);
+      for (size_t p = 0; p < k; p++)
+      {
+        T aip = trans_a ? a[p*m + i] : a[i*k + p];
+        // Masked (zero) coefficients are skipped, sparse connection tables cost nothing
+        if (aip == T(0))
+          continue;
+        Reg va = V::set1(aip);
+        const T *bp = b + p*n + j;
+        c0 = V::fmadd(va, V::load(bp), c0);
+        c1 = V::fmadd(va, V::load(bp + V::W), c1);
+        c2 = V::fmadd(va, V::load(bp + 2*V::W), c2);
+        c3 = V::fmadd(va, V::load(bp + 3*V::W), c3);
+      }
+      V::store(ci, c0); V::store(ci + V::W, c1); V::store(ci + 2*V::W, c2); V::store(ci + 3*V::W, c3);
+    }
+  }
+  for (; j + V::W <= j1; j += V::W)
+  {
+    for (size_t i = i0; i < i1; i++)
+    {
+      Reg c0 = V::load(c + i*n + j);
+      for (size_t p = 0; p < k; p++)
+      {
+        T aip = trans_a ? a[p*m + i] : a[i*k + p];
+        if (aip != T(0))
+          c0 = V::fmadd(V::set1(aip), V::load(b + p*n + j), c0);
+      }
+      V::store(c + i*n + j, c0);
+    }
+  }
+  for (; j < j1; j++)
+  {
+    for (size_t i = i0; i < i1; i++)
+    {
+      T cij = c[i*n + j];
+      for (size_t p = 0; p < k; p++)
+        cij = S::fmadd(trans_a ? a[p*m + i] : a[i*k + p], b[p*n + j], cij);
+      c[i*n + j] = cij;
+    }
+  }
+}
+
+/// C rows += op(A)[i] * B^T : each entry is a dot product of two rows,
+/// op(A)[i] is gathered by blocks when A is transposed
+template<class V> void GemmNT(
+  bool trans_a,
+  size_t m,
+  size_t n,
+  size_t k,
+  const typename V::Scalar *a,
+  const typename V::Scalar *b,
+  typename V::Scalar *c,
+  size_t i0,
+  size_t i1,
+  size_t j0,
+  size_t j1)
+{
+  typedef typename V::Scalar T;
+  const size_t block = 256;
+  T row[block];
+
+  for (size_t i = i0; i < i1; i++)
+  {
+    for (size_t p0 = 0; p0 < k; p0 += block)
+    {
+      size_t len = (k - p0 < block) ? k - p0 : block;
+      const T *ai = a + i*k + p0;
+      if (trans_a)
+      {
+        for (size_t p = 0; p < len; p++)
+          row[p] = a[(p0 + p)*m + i];
+        ai = row;
+      }
+      for (size_t j = j0; j < j1; j++)
+        c[i*n + j] += Dot<V>(len, ai, b + j*k + p0);
+    }
+  }
+}
+
+template<class V> void Gemm(
+  bool trans_a,
+  bool trans_b,
+  bool accumulate,
+  size_t m,
+  size_t n,
+  size_t k,
+  const typename V::Scalar *a,
+  const typename V::Scalar *b,
+  typename V::Scalar *c,
+  size_t i0,
+  size_t i1,
+  size_t j0,
+  size_t j1)
+{
+  typedef typename V::Scalar T;
+  if (!accumulate)
+  {
+    for (size_t i = i0; i < i1; i++)
+      for (size_t j = j0; j < j1; j++)
+        c[i*n + j] = T(0);
+  }
+
+  if (trans_b)
+    GemmNT<V>(trans_a, m, n, k, a, b, c, i0, i1, j0, j1);
+  else
+    GemmNN<V>(trans_a, m, n, k, a, b, c, i0, i1, j0, j1);
+}
+/*                                                  GEMM                                          */
+/**************************************************************************************************/
+
+                                          /***********************/
+
+/**************************************************************************************************/
+/*                                                Neurons                                         */
+/// tanh, Float32 uses a [13/6] rational approximation clamped where tanh rounds to +/-1
+/// (|error| < 4e-7, up to 7 ulps near +/-1, no exp), Float64 uses 2 / (1 + e^-2x) - 1 which doesn't overflow
+template<class V> inline typename V::Reg Tanh(typename V::Reg x) {
+  typedef typename V::Scalar T;
+  typedef typename V::Reg Reg;
+  if (sizeof(T) != 4)
+    return V::sub(V::div(V::set1(T(2)), V::add(V::set1(T(1)), V::exp(V::mul(V::set1(T(-2)), x)))), V::set1(T(1)));
+
+  const T clamp = T(7.90531110763549805);
+  x = V::min(V::max(x, V::set1(-clamp)), V::set1(clamp));
+  Reg x2 = V::mul(x, x);
+  Reg p = V::set1(T(-2.76076847742355e-16));
+  p = V::fmadd(p, x2, V::set1(T(2.00018790482477e-13)));
+  p = V::fmadd(p, x2, V::set1(T(-8.60467152213735e-11)));
+  p = V::fmadd(p, x2, V::set1(T(5.12229709037114e-08)));
+  p = V::fmadd(p, x2, V::set1(T(1.48572235717979e-05)));
+  p = V::fmadd(p, x2, V::set1(T(6.37261928875436e-04)));
+  p = V::fmadd(p, x2, V::set1(T(4.89352455891786e-03)));
+  Reg q = V::set1(T(1.19825839466702e-06));
+  q = V::fmadd(q, x2, V::set1(T(1.18534705686654e-04)));
+  q = V::fmadd(q, x2, V::set1(T(2.26843463243900e-03)));
+  q = V::fmadd(q, x2, V::set1(T(4.89352518554385e-03)));
+  return V::div(V::mul(x, p), q);
+}
+
+/// sigmoid, (1 + tanh(x/2)) / 2 in Float32, 1 / (1 + e^-x) in Float64
+template<class V> inline typename V::Reg Sigmoid(typename V::Reg x) {
+  typedef typename V::Scalar T;
+  if (sizeof(T) != 4)
+    return V::div(V::set1(T(1)), V::add(V::set1(T(1)), V::exp(V::sub(V::zero(), x))));
+  return V::fmadd(V::set1(T(0.5)), Tanh<V>(V::mul(V::set1(T(0.5)), x)), V::set1(T(0.5)));
+}
+
+/// Neurons as compile-time parameters, the loops are specialized instead of switching per element
+template<class V, int N> inline typename V::Reg Neuron(typename V::Reg x) {
+  switch (N)
+  {
+    case MK_SIMD_NEURON_SIGMOID: return Sigmoid<V>(x);
+    case MK_SIMD_NEURON_RECTIFIEDLINEAR: return V::max(V::zero(), x);
+    case MK_SIMD_NEURON_TANH: return Tanh<V>(x);
+    default: return x;
+  }
+}
+
+template<class V, int N> inline typename V::Reg NeuronDerivative(typename V::Reg y, typename V::Reg delta) {
+  typedef typename V::Scalar T;
+  switch (N)
+  {
+    case MK_SIMD_NEURON_SIGMOID: return V::mul(delta, V::mul(y, V::sub(V::set1(T(1)), y)));
+    case MK_SIMD_NEURON_RECTIFIEDLINEAR: return V::positive(y, delta);
+    case MK_SIMD_NEURON_TANH: return V::mul(delta, V::sub(V::set1(T(1)), V::mul(y, y)));
+    default: return delta;
+  }
+}
+
+template<class V, int N> void ActivationLoop(size_t n, const typename V::Scalar *x, typename V::Scalar *y) {
+  typedef MkSimdScalar<typename V::Scalar> S;
+  size_t i = 0;
+  for (; i + V::W <= n; i += V::W)
+    V::store(y + i, Neuron<V, N>(V::load(x + i)));
+  for (; i < n; i++)
+    y[i] = Neuron<S, N>(x[i]);
+}
+
+template<class V, int N> void DerivativeLoop(
+  size_t n,
+  const typename V::Scalar *y,
+  const typename V::Scalar *delta,
+  typename V::Scalar *out)
+{
+  typedef MkSimdScalar<typename V::Scalar> S;
+  size_t i = 0;
+  for (; i + V::W <= n; i += V::W)
+    V::store(out + i, NeuronDerivative<V, N>(V::load(y + i), V::load(delta + i)));
+  for (; i < n; i++)
+    out[i] = NeuronDerivative<S, N>(y[i], delta[i]);
+}
+
+template<class V> void Activation(int neuron, size_t n, const typename V::Scalar *x, typename V::Scalar *y) {
+  switch (neuron)
+  {
+    case MK_SIMD_NEURON_SIGMOID: ActivationLoop<V, MK_SIMD_NEURON_SIGMOID>(n, x, y); break;
+    case MK_SIMD_NEURON_RECTIFIEDLINEAR: ActivationLoop<V, MK_SIMD_NEURON_RECTIFIEDLINEAR>(n, x, y); break;
+    case MK_SIMD_NEURON_TANH: ActivationLoop<V, MK_SIMD_NEURON_TANH>(n, x, y); break;
+    default: ActivationLoop<V, MK_SIMD_NEURON_IDENTITY>(n, x, y); break;
+  }
+}
+
+template<class V> void Derivative(
+  int neuron,
+  size_t n,
+  const typename V::Scalar *y,
+  const typename V::Scalar *delta,
+  typename V::Scalar *out)
+{
+  switch (neuron)
+  {
+    case MK_SIMD_NEURON_SIGMOID: DerivativeLoop<V, MK_SIMD_NEURON_SIGMOID>(n, y, delta, out); break;
+    case MK_SIMD_NEURON_RECTIFIEDLINEAR: DerivativeLoop<V, MK_SIMD_NEURON_RECTIFIEDLINEAR>(n, y, delta, out); break;
+    case MK_SIMD_NEURON_TANH: DerivativeLoop<V, MK_SIMD_NEURON_TANH>(n, y, delta, out); break;
+    default: DerivativeLoop<V, MK_SIMD_NEURON_IDENTITY>(n, y, delta, out); break;
+  }
+}
+/*                                                Neurons                                         */
+/**************************************************************************************************/
+
+                                          /***********************/
+
+/**************************************************************************************************/
+/*                                               Optimizers                                       */
+template<class V> void Update(
+  size_t n,
+  double alpha,
+  double mu,
+  const typename V::Scalar *dw,
+  const typename V::Scalar *h,
+  typename V::Scalar *w)
+{
+  typedef typename V::Scalar T;
+  typedef MkSimdScalar<T> S;
+  const T *hh = h ? h : w;
+  typename V::Reg va = V::set1(T(alpha)), vmu = V::set1(T(mu));
+
+  size_t i = 0;
+  for (; i + V::W <= n; i += V::W)
+  {
+    typename V::Reg rate = V::div(va, V::add(V::load(hh + i), vmu));
+    V::store(w + i, V::sub(V::load(w + i), V::mul(rate, V::load(dw + i))));
+  }
+  for (; i < n; i++)
+    w[i] = S::sub(w[i], S::mul(S::div(T(alpha), S::add(hh[i], T(mu))), dw[i]));
+}
+
+/// The master weights are Float64 whatever T is, the loop is left to the compiler vectorizer
+template<class V> void UpdateMaster(
+  size_t n,
+  double alpha,
+  double mu,
+  const typename V::Scalar *dw,
+  const typename V::Scalar *h,
+  double *master,
+  typename V::Scalar *w)
+{
+  typedef typename V::Scalar T;
+  for (size_t i = 0; i < n; i++)
+  {
+    double hi = h ? double(h[i]) : master[i];
+    master[i] -= alpha / (hi + mu) * double(dw[i]);
+    w[i] = T(master[i]);
+  }
+}
+/*                                               Optimizers                                       */
+/**************************************************************************************************/
+
+template<class V> void MkSimdFillKernels(MkSimdKernels<typename V::Scalar> &kernels) {
+  kernels.dot = &Dot<V>;
+  kernels.axpy = &Axpy<V>;
+  kernels.gemv = &Gemv<V>;
+  kernels.gemm = &Gemm<V>;
+  kernels.activation = &Activation<V>;
+  kernels.derivative = &Derivative<V>;
+  kernels.update = &Update<V>;
+  kernels.updateMaster = &UpdateMaster<V>;
+}
+
+} // namespace
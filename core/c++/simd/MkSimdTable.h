@@ -0,0 +1,87 @@
+/**************************************************************************************************/
+/*                                                                                                */
+/*  Informations :                                                                                */
+/*      This code is part of the project MLKL                                                     */
+/*                                                                                                */
+/*  Contacts :                                                                                    */
+/*      couet.julien@gmail.com                                                                    */
+/*                                                                                                */
+/**************************************************************************************************/
+
+#ifndef __MK_SIMD_TABLE_H__
+#define __MK_SIMD_TABLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// Instruction sets, each one is compiled in its own translation unit
+/// with the matching flags, and selected at runtime from the cpuid
+enum MkSimdLevel {
+  MK_SIMD_SCALAR = 0,
+  MK_SIMD_SSE2 = 1,
+  MK_SIMD_AVX2 = 2,
+  MK_SIMD_AVX512 = 3
+};
+
+/// Neurons, same values as MK_NEURON_XXX in MkCNNFunction.kl
+enum MkSimdNeuron {
+  MK_SIMD_NEURON_IDENTITY = 0,
+  MK_SIMD_NEURON_SIGMOID = 1,
+  MK_SIMD_NEURON_RECTIFIEDLINEAR = 2,
+  MK_SIMD_NEURON_TANH = 3
+};
+
+/// Kernels of one instruction set for one precision
+/// Matrices are row-major, the ranges let the callers split the work between threads
+template<typename T> struct MkSimdKernels {
+
+  /// Return sum(a[i] * b[i])
+  T (*dot)(size_t n, const T *a, const T *b);
+
+  /// y += alpha * x
+  void (*axpy)(size_t n, T alpha, const T *x, T *y);
+
+  /// y[begin, end) = op(A) * x + beta * y, A is [m x n], op(A) = A^T if trans
+  void (*gemv)(bool trans, size_t m, size_t n, const T *a, const T *x, T beta, T *y,
+    size_t begin, size_t end);
+
+  /// C[i0, i1)[j0, j1) = op(A) * op(B) (+ C if accumulate)
+  /// op(A) is [m x k], op(B) is [k x n] and C is [m x n]
+  void (*gemm)(bool trans_a, bool trans_b, bool accumulate, size_t m, size_t n, size_t k,
+    const T *a, const T *b, T *c, size_t i0, size_t i1, size_t j0, size_t j1);
+
+  /// y = f(x), neuron is a MkSimdNeuron, x and y can alias
+  void (*activation)(int neuron, size_t n, const T *x, T *y);
+
+  /// out = delta * f'(y), f' is expressed with the neuron outputs y, out and delta can alias
+  void (*derivative)(int neuron, size_t n, const T *y, const T *delta, T *out);
+
+  /// w -= alpha / (h + mu) * dw, h == NULL uses w itself (MkCNNOptimizerGD)
+  void (*update)(size_t n, double alpha, double mu, const T *dw, const T *h, T *w);
+
+  /// master -= alpha / (h + mu) * dw and w = master, h == NULL uses master itself
+  void (*updateMaster)(size_t n, double alpha, double mu, const T *dw, const T *h, double *master, T *w);
+};
+
+/// All the kernels of an instruction set
+struct MkSimdTable {
+  int level;
+  const char *name;
+  MkSimdKernels<float> f32;
+  MkSimdKernels<double> f64;
+
+  /// Return sum(a[i] * b[i]) accumulated in 32 bits, the products of the quantized inferences
+  int32_t (*dotInt8)(size_t n, const int8_t *a, const int8_t *b);
+};
+
+/// Fill the table of an instruction set, defined by MkSimd_<isa>.cpp
+void MkSimdTableScalar(MkSimdTable &table);
+void MkSimdTableSSE2(MkSimdTable &table);
+void MkSimdTableAVX2(MkSimdTable &table);
+void MkSimdTableAVX512(MkSimdTable &table);
+
+/// Best table supported by the CPU, MLKL_SIMD=scalar|sse2|avx2|avx512 caps the level
+const MkSimdTable &MkSimdGetTable();
+
+#endif // __MK_SIMD_TABLE_H__
@@ -0,0 +1,118 @@
+/**************************************************************************************************/
+/*                                                                                                */
+/*  Informations :                                                                                */
+/*      This code is part of the project MLKL                                                     */
+/*                                                                                                */
+/*  Contacts :                                                                                    */
+/*      couet.julien@gmail.com                                                                    */
+/*                                                                                                */
+/**************************************************************************************************/
+
+// AVX2 + FMA kernels, compiled with /arch:AVX2 (-mavx2 -mfma)
+#include <math.h>
+#include <immintrin.h>
+#include <MkSimdTable.h>
+#include <MkSimdKernels.h>
+
+namespace {
+
+inline float HSum128(__m128 x) {
+  x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+  return _mm_cvtss_f32(x);
+}
+
+struct MkSimdAVX2Float {
+  typedef float Scalar;
+  typedef __m256 Reg;
+  enum { W = 8 };
+
+  static inline Reg load(const float *p) { return _mm256_loadu_ps(p); }
+  static inline void store(float *p, Reg x) { _mm256_storeu_ps(p, x); }
+  static inline Reg set1(float x) { return _mm256_set1_ps(x); }
+  static inline Reg zero() { return _mm256_setzero_ps(); }
+  static inline Reg add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+  static inline Reg sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+  static inline Reg mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+  static inline Reg div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+  static inline Reg fmadd(Reg a, Reg b, Reg c) { return _mm256_fmadd_ps(a, b, c); }
+  static inline Reg min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+  static inline Reg max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+  static inline Reg round(Reg x) { return _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static inline Reg pow2n(Reg n) { 
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23)); 
+  }
+  static inline Reg exp(Reg x) { return MkSimdExp<MkSimdAVX2Float>(x); }
+  static inline Reg positive(Reg y, Reg d) { return _mm256_and_ps(_mm256_cmp_ps(y, _mm256_setzero_ps(), _CMP_GT_OQ), d); }
+  static inline float hsum(Reg x) { return HSum128(_mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1))); }
+};
+
+struct MkSimdAVX2Double {
+  typedef double Scalar;
+  typedef __m256d Reg;
+  enum { W = 4 };
+
+  static inline Reg load(const double *p) { return _mm256_loadu_pd(p); }
+  static inline void store(double *p, Reg x) { _mm256_storeu_pd(p, x); }
+  static inline Reg set1(double x) { return _mm256_set1_pd(x); }
+  static inline Reg zero() { return _mm256_setzero_pd(); }
+  static inline Reg add(Reg a, Reg b) { return _mm256_add_pd(a, b); }
+  static inline Reg sub(Reg a, Reg b) { return _mm256_sub_pd(a, b); }
+  static inline Reg mul(Reg a, Reg b) { return _mm256_mul_pd(a, b); }
+  static inline Reg div(Reg a, Reg b) { return _mm256_div_pd(a, b); }
+  static inline Reg fmadd(Reg a, Reg b, Reg c) { return _mm256_fmadd_pd(a, b, c); }
+  static inline Reg min(Reg a, Reg b) { return _mm256_min_pd(a, b); }
+  static inline Reg max(Reg a, Reg b) { return _mm256_max_pd(a, b); }
+  static inline Reg round(Reg x) { return _mm256_round_pd(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static inline Reg pow2n(Reg n) { 
+    // n + 1023 is positive in the clamped range, so it can be zero-extended to 64 bits
+    __m128i e = _mm_add_epi32(_mm256_cvtpd_epi32(n), _mm_set1_epi32(1023));
+    return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_cvtepu32_epi64(e), 52)); 
+  }
+  static inline Reg exp(Reg x) { return MkSimdExp<MkSimdAVX2Double>(x); }
+  static inline Reg positive(Reg y, Reg d) { return _mm256_and_pd(_mm256_cmp_pd(y, _mm256_setzero_pd(), _CMP_GT_OQ), d); }
+  static inline double hsum(Reg x) { 
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+  }
+};
+
+/// 16 bytes are sign-extended to 16 bits per register, _mm256_madd_epi16 sums the pairs of products in 32 bits
+/// The signed x signed products can't use _mm256_maddubs_epi16 (unsigned x signed, saturated)
+int32_t DotInt8(size_t n, const int8_t *a, const int8_t *b) {
+  __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    __m256i a0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a + i)));
+    __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b + i)));
+    __m256i a1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a + i + 16)));
+    __m256i b1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b + i + 16)));
+    acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(a0, b0));
+    acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(a1, b1));
+  }
+  for (; i + 16 <= n; i += 16)
+  {
+    __m256i a0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a + i)));
+    __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b + i)));
+    acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(a0, b0));
+  }
+  acc0 = _mm256_add_epi32(acc0, acc1);
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+  int32_t sum = _mm_cvtsi128_si32(s);
+  for (; i < n; i++)
+    sum += int32_t(a[i]) * int32_t(b[i]);
+  return sum;
+}
+
+} // namespace
+
+void MkSimdTableAVX2(MkSimdTable &table) {
+  table.level = MK_SIMD_AVX2;
+  table.name = "avx2";
+  MkSimdFillKernels<MkSimdAVX2Float>(table.f32);
+  MkSimdFillKernels<MkSimdAVX2Double>(table.f64);
+  table.dotInt8 = &DotInt8;
+}
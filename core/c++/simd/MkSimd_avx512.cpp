@@ -0,0 +1,99 @@
+/**************************************************************************************************/
+/*                                                                                                */
+/*  Informations :                                                                                */
+/*      This code is part of the project MLKL                                                     */
+/*                                                                                                */
+/*  Contacts :                                                                                    */
+/*      couet.julien@gmail.com                                                                    */
+/*                                                                                                */
+/**************************************************************************************************/
+
+// AVX-512F kernels, compiled with /arch:AVX512 (-mavx512f)
+#include <math.h>
+#include <immintrin.h>
+#include <MkSimdTable.h>
+#include <MkSimdKernels.h>
+
+namespace {
+
+struct MkSimdAVX512Float {
+  typedef float Scalar;
+  typedef __m512 Reg;
+  enum { W = 16 };
+
+  static inline Reg load(const float *p) { return _mm512_loadu_ps(p); }
+  static inline void store(float *p, Reg x) { _mm512_storeu_ps(p, x); }
+  static inline Reg set1(float x) { return _mm512_set1_ps(x); }
+  static inline Reg zero() { return _mm512_setzero_ps(); }
+  static inline Reg add(Reg a, Reg b) { return _mm512_add_ps(a, b); }
+  static inline Reg sub(Reg a, Reg b) { return _mm512_sub_ps(a, b); }
+  static inline Reg mul(Reg a, Reg b) { return _mm512_mul_ps(a, b); }
+  static inline Reg div(Reg a, Reg b) { return _mm512_div_ps(a, b); }
+  static inline Reg fmadd(Reg a, Reg b, Reg c) { return _mm512_fmadd_ps(a, b, c); }
+  static inline Reg min(Reg a, Reg b) { return _mm512_min_ps(a, b); }
+  static inline Reg max(Reg a, Reg b) { return _mm512_max_ps(a, b); }
+  static inline Reg round(Reg x) { return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static inline Reg pow2n(Reg n) { return _mm512_scalef_ps(_mm512_set1_ps(1.0f), n); }
+  static inline Reg exp(Reg x) { return MkSimdExp<MkSimdAVX512Float>(x); }
+  static inline Reg positive(Reg y, Reg d) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(y, _mm512_setzero_ps(), _CMP_GT_OQ), d); }
+  static inline float hsum(Reg x) { return _mm512_reduce_add_ps(x); }
+};
+
+struct MkSimdAVX512Double {
+  typedef double Scalar;
+  typedef __m512d Reg;
+  enum { W = 8 };
+
+  static inline Reg load(const double *p) { return _mm512_loadu_pd(p); }
+  static inline void store(double *p, Reg x) { _mm512_storeu_pd(p, x); }
+  static inline Reg set1(double x) { return _mm512_set1_pd(x); }
+  static inline Reg zero() { return _mm512_setzero_pd(); }
+  static inline Reg add(Reg a, Reg b) { return _mm512_add_pd(a, b); }
+  static inline Reg sub(Reg a, Reg b) { return _mm512_sub_pd(a, b); }
+  static inline Reg mul(Reg a, Reg b) { return _mm512_mul_pd(a, b); }
+  static inline Reg div(Reg a, Reg b) { return _mm512_div_pd(a, b); }
+  static inline Reg fmadd(Reg a, Reg b, Reg c) { return _mm512_fmadd_pd(a, b, c); }
+  static inline Reg min(Reg a, Reg b) { return _mm512_min_pd(a, b); }
+  static inline Reg max(Reg a, Reg b) { return _mm512_max_pd(a, b); }
+  static inline Reg round(Reg x) { return _mm512_roundscale_pd(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static inline Reg pow2n(Reg n) { return _mm512_scalef_pd(_mm512_set1_pd(1.0), n); }
+  static inline Reg exp(Reg x) { return MkSimdExp<MkSimdAVX512Double>(x); }
+  static inline Reg positive(Reg y, Reg d) { return _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(y, _mm512_setzero_pd(), _CMP_GT_OQ), d); }
+  static inline double hsum(Reg x) { return _mm512_reduce_add_pd(x); }
+};
+
+/// AVX-512F only : 16 bytes are sign-extended to 32 bits and multiplied in 32 bits
+/// (the 16-bit madd needs AVX-512BW, vpdpbusd needs VNNI and unsigned inputs)
+int32_t DotInt8(size_t n, const int8_t *a, const int8_t *b) {
+  __m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    __m512i a0 = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i *)(a + i)));
+    __m512i b0 = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i *)(b + i)));
+    __m512i a1 = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i *)(a + i + 16)));
+    __m512i b1 = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i *)(b + i + 16)));
+    acc0 = _mm512_add_epi32(acc0, _mm512_mullo_epi32(a0, b0));
+    acc1 = _mm512_add_epi32(acc1, _mm512_mullo_epi32(a1, b1));
+  }
+  for (; i + 16 <= n; i += 16)
+  {
+    __m512i a0 = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i *)(a + i)));
+    __m512i b0 = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i *)(b + i)));
+    acc0 = _mm512_add_epi32(acc0, _mm512_mullo_epi32(a0, b0));
+  }
+  int32_t sum = _mm512_reduce_add_epi32(_mm512_add_epi32(acc0, acc1));
+  for (; i < n; i++)
+    sum += int32_t(a[i]) * int32_t(b[i]);
+  return sum;
+}
+
+} // namespace
+
+void MkSimdTableAVX512(MkSimdTable &table) {
+  table.level = MK_SIMD_AVX512;
+  table.name = "avx512";
+  MkSimdFillKernels<MkSimdAVX512Float>(table.f32);
+  MkSimdFillKernels<MkSimdAVX512Double>(table.f64);
+  table.dotInt8 = &DotInt8;
+}
@@ -0,0 +1,33 @@
+/**************************************************************************************************/
+/*                                                                                                */
+/*  Informations :                                                                                */
+/*      This code is part of the project MLKL                                                     */
+/*                                                                                                */
+/*  Contacts :                                                                                    */
+/*      couet.julien@gmail.com                                                                    */
+/*                                                                                                */
+/**************************************************************************************************/
+
+// Portable fallback, compiled without any instruction set flag
+#include <math.h>
+#include <MkSimdTable.h>
+#include <MkSimdKernels.h>
+
+namespace {
+
+int32_t DotInt8(size_t n, const int8_t *a, const int8_t *b) {
+  int32_t sum = 0;
+  for (size_t i = 0; i < n; i++)
+    sum += int32_t(a[i]) * int32_t(b[i]);
+  return sum;
+}
+
+} // namespace
+
+void MkSimdTableScalar(MkSimdTable &table) {
+  table.level = MK_SIMD_SCALAR;
+  table.name = "scalar";
+  MkSimdFillKernels< MkSimdScalar<float> >(table.f32);
+  MkSimdFillKernels< MkSimdScalar<double> >(table.f64);
+  table.dotInt8 = &DotInt8;
+}
@@ -0,0 +1,107 @@
+/**************************************************************************************************/
+/*                                                                                                */
+/*  Informations :                                                                                */
+/*      This code is part of the project MLKL                                                     */
+/*                                                                                                */
+/*  Contacts :                                                                                    */
+/*      couet.julien@gmail.com                                                                    */
+/*                                                                                                */
+/**************************************************************************************************/
+
+// SSE2 kernels, part of x86-64 : no flag needed, used when AVX2 isn't there
+#include <math.h>
+#include <emmintrin.h>
+#include <MkSimdTable.h>
+#include <MkSimdKernels.h>
+
+namespace {
+
+struct MkSimdSSE2Float {
+  typedef float Scalar;
+  typedef __m128 Reg;
+  enum { W = 4 };
+
+  static inline Reg load(const float *p) { return _mm_loadu_ps(p); }
+  static inline void store(float *p, Reg x) { _mm_storeu_ps(p, x); }
+  static inline Reg set1(float x) { return _mm_set1_ps(x); }
+  static inline Reg zero() { return _mm_setzero_ps(); }
+  static inline Reg add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+  static inline Reg sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+  static inline Reg mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+  static inline Reg div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+  static inline Reg fmadd(Reg a, Reg b, Reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+  static inline Reg min(Reg a, Reg b) { return _mm_min_ps(a, b); }
+  static inline Reg max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+  static inline Reg round(Reg x) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(x)); }
+  static inline Reg pow2n(Reg n) { 
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23)); 
+  }
+  static inline Reg exp(Reg x) { return MkSimdExp<MkSimdSSE2Float>(x); }
+  static inline Reg positive(Reg y, Reg d) { return _mm_and_ps(_mm_cmpgt_ps(y, _mm_setzero_ps()), d); }
+  static inline float hsum(Reg x) {
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+    return _mm_cvtss_f32(x);
+  }
+};
+
+struct MkSimdSSE2Double {
+  typedef double Scalar;
+  typedef __m128d Reg;
+  enum { W = 2 };
+
+  static inline Reg load(const double *p) { return _mm_loadu_pd(p); }
+  static inline void store(double *p, Reg x) { _mm_storeu_pd(p, x); }
+  static inline Reg set1(double x) { return _mm_set1_pd(x); }
+  static inline Reg zero() { return _mm_setzero_pd(); }
+  static inline Reg add(Reg a, Reg b) { return _mm_add_pd(a, b); }
+  static inline Reg sub(Reg a, Reg b) { return _mm_sub_pd(a, b); }
+  static inline Reg mul(Reg a, Reg b) { return _mm_mul_pd(a, b); }
+  static inline Reg div(Reg a, Reg b) { return _mm_div_pd(a, b); }
+  static inline Reg fmadd(Reg a, Reg b, Reg c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+  static inline Reg min(Reg a, Reg b) { return _mm_min_pd(a, b); }
+  static inline Reg max(Reg a, Reg b) { return _mm_max_pd(a, b); }
+  static inline Reg round(Reg x) { return _mm_cvtepi32_pd(_mm_cvtpd_epi32(x)); }
+  static inline Reg pow2n(Reg n) { 
+    // n + 1023 is positive in the clamped range, so it can be zero-extended to 64 bits
+    __m128i e = _mm_add_epi32(_mm_cvtpd_epi32(n), _mm_set1_epi32(1023));
+    return _mm_castsi128_pd(_mm_slli_epi64(_mm_unpacklo_epi32(e, _mm_setzero_si128()), 52)); 
+  }
+  static inline Reg exp(Reg x) { return MkSimdExp<MkSimdSSE2Double>(x); }
+  static inline Reg positive(Reg y, Reg d) { return _mm_and_pd(_mm_cmpgt_pd(y, _mm_setzero_pd()), d); }
+  static inline double hsum(Reg x) { return _mm_cvtsd_f64(_mm_add_sd(x, _mm_unpackhi_pd(x, x))); }
+};
+
+/// The bytes are sign-extended to 16 bits (unpack with themselves then shift), 
+/// _mm_madd_epi16 sums the pairs of products in 32 bits
+int32_t DotInt8(size_t n, const int8_t *a, const int8_t *b) {
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+    __m128i a_lo = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8);
+    __m128i a_hi = _mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8);
+    __m128i b_lo = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8);
+    __m128i b_hi = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(a_lo, b_lo));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(a_hi, b_hi));
+  }
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  int32_t sum = _mm_cvtsi128_si32(acc);
+  for (; i < n; i++)
+    sum += int32_t(a[i]) * int32_t(b[i]);
+  return sum;
+}
+
+} // namespace
+
+void MkSimdTableSSE2(MkSimdTable &table) {
+  table.level = MK_SIMD_SSE2;
+  table.name = "sse2";
+  MkSimdFillKernels<MkSimdSSE2Float>(table.f32);
+  MkSimdFillKernels<MkSimdSSE2Double>(table.f64);
+  table.dotInt8 = &DotInt8;
+}